@@ -0,0 +1,578 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "physics.h"
+#include "nn.h"
+#include "genetics.h"
+#include "simulation.h"
+#include "novelty.h"
+#include "threadpool.h"
+#include "rng.h"
+#include "simd.h"
+#include "timer.h"
+
+#define NN_INPUTS 8
+#define NN_HIDDEN 16
+#define NN_OUTPUTS 4
+#define CONSTRAINT_ITERATIONS 5
+
+#define DEFAULT_REPS 10
+#define DEFAULT_WARMUP 2
+#define MIN_REP_SECONDS 0.02 // Passes per repetition are doubled until one takes this long
+#define MAX_SIZES 16
+#define MAX_RESULTS 128
+
+// A chain skeleton with the simulation's point and constraint counts
+#define BENCH_POINTS NUM_POINTS
+#define BENCH_CONSTRAINTS NUM_CONSTRAINTS
+#define BENCH_LINK 30.0f
+
+// Novelty queries: one batch of behaviors scored against an archive of
+// the benchmark size. The brute-force reference is skipped for archives
+// where one pass would take seconds.
+#define NOVELTY_BATCH 1024
+#define NOVELTY_NEIGHBOURS 15
+#define NOVELTY_BRUTE_MAX 65536
+
+// Runs `passes` passes of a benchmark over its prepared data
+typedef void (*BenchFn)(void* ctx, int passes);
+
+typedef struct {
+    char name[32];
+    int size;
+    const char* unit;
+    int passes;
+    double p10;
+    double median;
+    double p90;
+    double min;
+    double max;
+    double ms_per_pass; // Median
+} BenchResult;
+
+static BenchResult results[MAX_RESULTS];
+static int result_count = 0;
+static int bench_reps = DEFAULT_REPS;
+static int bench_warmup = DEFAULT_WARMUP;
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const double* sorted, int count, double p) {
+    int rank = (int)ceil(p / 100.0 * count) - 1;
+    if (rank < 0) rank = 0;
+    if (rank >= count) rank = count - 1;
+    return sorted[rank];
+}
+
+// Times `fn` and records `work_per_pass` units per pass as a rate. The
+// pass count is calibrated first, which doubles as the first warmup.
+static void bench_run(const char* name, int size, const char* unit, double work_per_pass, BenchFn fn, void* ctx) {
+    int passes = 1;
+    for (;;) {
+        double start = timer_now();
+        fn(ctx, passes);
+        if (timer_now() - start >= MIN_REP_SECONDS || passes >= (1 << 24)) break;
+        passes *= 2;
+    }
+    for (int i = 0; i < bench_warmup; i++) fn(ctx, passes);
+
+    double* rates = (double*)malloc(bench_reps * sizeof(double));
+    double* seconds = (double*)malloc(bench_reps * sizeof(double));
+    for (int i = 0; i < bench_reps; i++) {
+        double start = timer_now();
+        fn(ctx, passes);
+        double elapsed = timer_now() - start;
+        if (elapsed <= 0) elapsed = 1e-9;
+        seconds[i] = elapsed / passes;
+        rates[i] = work_per_pass * passes / elapsed;
+    }
+    qsort(rates, bench_reps, sizeof(double), compare_double);
+    qsort(seconds, bench_reps, sizeof(double), compare_double);
+
+    if (result_count < MAX_RESULTS) {
+        BenchResult* r = &results[result_count++];
+        snprintf(r->name, sizeof(r->name), "%s", name);
+        r->size = size;
+        r->unit = unit;
+        r->passes = passes;
+        r->p10 = percentile(rates, bench_reps, 10);
+        r->median = percentile(rates, bench_reps, 50);
+        r->p90 = percentile(rates, bench_reps, 90);
+        r->min = rates[0];
+        r->max = rates[bench_reps - 1];
+        r->ms_per_pass = percentile(seconds, bench_reps, 50) * 1000.0;
+        printf("%-22s %8d %14.0f %-18s p10 %-14.0f p90 %-14.0f %10.3f ms/pass\n",
+               r->name, size, r->median, unit, r->p10, r->p90, r->ms_per_pass);
+        fflush(stdout);
+    }
+    free(rates);
+    free(seconds);
+}
+
+static float bench_tanh_error(void) {
+    float max_error = 0;
+    float worst_x = 0;
+    float xs[SIMD_WIDTH];
+    float ys[SIMD_WIDTH];
+    for (int i = -2000000; i < 2000000; i += SIMD_WIDTH) {
+        for (int l = 0; l < SIMD_WIDTH; l++) xs[l] = (i + l) * 5e-6f;
+        simd_store(ys, simd_tanh(simd_load(xs)));
+        for (int l = 0; l < SIMD_WIDTH; l++) {
+            float error = fabsf(ys[l] - tanhf(xs[l]));
+            if (error > max_error) {
+                max_error = error;
+                worst_x = xs[l];
+            }
+        }
+    }
+    printf("simd_tanh max abs error on [-10, 10]: %.3g (at x=%.4f)\n", max_error, worst_x);
+    return max_error;
+}
+
+// --- Neural networks ---
+
+typedef struct {
+    int count;
+    NeuralNetwork** nets;
+    NNBatch* batch;
+    float* inputs;
+    float* outputs;
+} NNBench;
+
+static void nn_scalar_pass(void* ctx, int passes) {
+    NNBench* b = (NNBench*)ctx;
+    int stride = b->batch->stride;
+    float in[NN_INPUTS];
+    float out[NN_OUTPUTS];
+    for (int pass = 0; pass < passes; pass++) {
+        for (int i = 0; i < b->count; i++) {
+            for (int j = 0; j < NN_INPUTS; j++) in[j] = b->inputs[j * stride + i];
+            nn_run(b->nets[i], in, out);
+            for (int j = 0; j < NN_OUTPUTS; j++) b->outputs[j * stride + i] = out[j];
+        }
+    }
+}
+
+static void nn_batch_pass(void* ctx, int passes) {
+    NNBench* b = (NNBench*)ctx;
+    for (int pass = 0; pass < passes; pass++) {
+        nn_batch_run(b->batch, 0, b->batch->stride, b->inputs, b->outputs);
+    }
+}
+
+static void nn_generic_pass(void* ctx, int passes) {
+    NNBench* b = (NNBench*)ctx;
+    for (int pass = 0; pass < passes; pass++) {
+        nn_batch_run_generic(b->batch, 0, b->batch->stride, b->inputs, b->outputs);
+    }
+}
+
+static void bench_nn(int count) {
+    Rng rng;
+    rng_seed(&rng, 1, 0);
+
+    NNBench b;
+    b.count = count;
+    b.nets = (NeuralNetwork**)malloc(count * sizeof(NeuralNetwork*));
+    b.batch = nn_batch_create(count, NN_INPUTS, NN_HIDDEN, NN_OUTPUTS, GENOME_F32);
+    int stride = b.batch->stride;
+    b.inputs = (float*)simd_alloc(NN_INPUTS * stride * sizeof(float));
+    b.outputs = (float*)simd_alloc(NN_OUTPUTS * stride * sizeof(float));
+
+    for (int i = 0; i < count; i++) {
+        b.nets[i] = nn_create(NN_INPUTS, NN_HIDDEN, NN_OUTPUTS);
+        nn_randomize(b.nets[i], &rng);
+        nn_batch_load(b.batch, i, b.nets[i]);
+        for (int j = 0; j < NN_INPUTS; j++) b.inputs[j * stride + i] = rng_symmetric(&rng);
+    }
+
+    // Check the batched path against the reference before timing it
+    float* reference = (float*)malloc(NN_OUTPUTS * stride * sizeof(float));
+    nn_scalar_pass(&b, 1);
+    memcpy(reference, b.outputs, NN_OUTPUTS * stride * sizeof(float));
+    nn_batch_pass(&b, 1);
+    float max_diff = 0;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < NN_OUTPUTS; j++) {
+            float diff = fabsf(b.outputs[j * stride + i] - reference[j * stride + i]);
+            if (diff > max_diff) max_diff = diff;
+        }
+    }
+    if (max_diff > 1e-4f) printf("warning: nn_batch_run differs from nn_run by %.3g\n", max_diff);
+
+    // The specialized kernel must match the generic loop bit for bit
+    memcpy(reference, b.outputs, NN_OUTPUTS * stride * sizeof(float));
+    nn_generic_pass(&b, 1);
+    if (memcmp(reference, b.outputs, NN_OUTPUTS * stride * sizeof(float)) != 0) {
+        printf("warning: nn_batch_run differs from nn_batch_run_generic\n");
+    }
+
+    bench_run("nn_run", count, "networks/sec", count, nn_scalar_pass, &b);
+    bench_run("nn_batch_generic", count, "networks/sec", count, nn_generic_pass, &b);
+    bench_run("nn_batch_run", count, "networks/sec", count, nn_batch_pass, &b);
+
+    // The same networks with compact weights, widened in registers
+    static const GenomeFormat formats[] = {GENOME_F16, GENOME_I8};
+    static const char* names[] = {"nn_batch_f16", "nn_batch_i8"};
+    NNBatch* f32_batch = b.batch;
+    for (int f = 0; f < 2; f++) {
+        b.batch = nn_batch_create(count, NN_INPUTS, NN_HIDDEN, NN_OUTPUTS, formats[f]);
+        for (int i = 0; i < count; i++) nn_batch_load(b.batch, i, b.nets[i]);
+        bench_run(names[f], count, "networks/sec", count, nn_batch_pass, &b);
+        nn_batch_destroy(b.batch);
+    }
+    b.batch = f32_batch;
+
+    for (int i = 0; i < count; i++) nn_destroy(b.nets[i]);
+    free(b.nets);
+    free(reference);
+    simd_free(b.inputs);
+    simd_free(b.outputs);
+    nn_batch_destroy(b.batch);
+}
+
+// --- Physics ---
+
+typedef struct {
+    int count;
+    PointMass* points;       // count * BENCH_POINTS, creature-major
+    Constraint* constraints; // count * BENCH_CONSTRAINTS
+    PhysicsStore* store;
+} PhysicsBench;
+
+// Slightly perturbed chain, so every constraint has work to do
+static Vec2D bench_pose(Rng* rng, int point) {
+    return (Vec2D){point * BENCH_LINK + rng_symmetric(rng) * 5.0f, 300.0f + rng_symmetric(rng) * 5.0f};
+}
+
+static void constraint_scalar_pass(void* ctx, int passes) {
+    PhysicsBench* b = (PhysicsBench*)ctx;
+    for (int pass = 0; pass < passes; pass++) {
+        for (int i = 0; i < b->count; i++) {
+            Constraint* c = &b->constraints[i * BENCH_CONSTRAINTS];
+            for (int it = 0; it < CONSTRAINT_ITERATIONS; it++) {
+                for (int j = 0; j < BENCH_CONSTRAINTS; j++) satisfy_constraint(&c[j]);
+            }
+        }
+    }
+}
+
+static void constraint_store_pass(void* ctx, int passes) {
+    PhysicsBench* b = (PhysicsBench*)ctx;
+    for (int pass = 0; pass < passes; pass++) {
+        physics_store_solve_constraints(b->store, 0, b->store->stride, CONSTRAINT_ITERATIONS);
+    }
+}
+
+static void integrate_scalar_pass(void* ctx, int passes) {
+    PhysicsBench* b = (PhysicsBench*)ctx;
+    int total = b->count * BENCH_POINTS;
+    for (int pass = 0; pass < passes; pass++) {
+        for (int i = 0; i < total; i++) update_point_mass(&b->points[i], 1.0f / 60.0f);
+    }
+}
+
+static void integrate_store_pass(void* ctx, int passes) {
+    PhysicsBench* b = (PhysicsBench*)ctx;
+    for (int pass = 0; pass < passes; pass++) {
+        physics_store_integrate(b->store, 0, b->store->stride, 1.0f / 60.0f, 0.0f, 1e9f);
+    }
+}
+
+static void bench_physics(int count) {
+    Rng rng;
+    rng_seed(&rng, 2, 0);
+
+    float masses[BENCH_POINTS];
+    ConstraintDef defs[BENCH_CONSTRAINTS];
+    for (int p = 0; p < BENCH_POINTS; p++) masses[p] = 1.0f;
+    for (int j = 0; j < BENCH_CONSTRAINTS; j++) defs[j] = (ConstraintDef){j, j + 1, BENCH_LINK};
+
+    PhysicsBench b;
+    b.count = count;
+    b.points = (PointMass*)malloc((size_t)count * BENCH_POINTS * sizeof(PointMass));
+    b.constraints = (Constraint*)malloc((size_t)count * BENCH_CONSTRAINTS * sizeof(Constraint));
+    b.store = physics_store_create(count, BENCH_POINTS, masses, defs, BENCH_CONSTRAINTS);
+
+    Vec2D pose[BENCH_POINTS];
+    for (int i = 0; i < count; i++) {
+        PointMass* points = &b.points[i * BENCH_POINTS];
+        for (int p = 0; p < BENCH_POINTS; p++) {
+            pose[p] = bench_pose(&rng, p);
+            points[p] = (PointMass){pose[p], pose[p], {0, 0}, masses[p]};
+        }
+        for (int j = 0; j < BENCH_CONSTRAINTS; j++) {
+            b.constraints[i * BENCH_CONSTRAINTS + j] = (Constraint){&points[j], &points[j + 1], BENCH_LINK};
+        }
+        physics_store_set_pose(b.store, i, pose);
+    }
+
+    double solves = (double)count * BENCH_CONSTRAINTS * CONSTRAINT_ITERATIONS;
+    double updates = (double)count * BENCH_POINTS;
+    bench_run("satisfy_constraint", count, "constraints/sec", solves, constraint_scalar_pass, &b);
+    bench_run("solve_constraints", count, "constraints/sec", solves, constraint_store_pass, &b);
+    bench_run("update_point_mass", count, "points/sec", updates, integrate_scalar_pass, &b);
+    bench_run("integrate", count, "points/sec", updates, integrate_store_pass, &b);
+
+    free(b.points);
+    free(b.constraints);
+    physics_store_destroy(b.store);
+}
+
+// --- Genetic algorithm ---
+
+typedef struct {
+    Population* pop;
+    ThreadPool* pool;
+    Rng rng;
+} GABench;
+
+static void ga_pass(void* ctx, int passes) {
+    GABench* b = (GABench*)ctx;
+    for (int pass = 0; pass < passes; pass++) {
+        for (int i = 0; i < b->pop->population_size; i++) {
+            b->pop->creatures[i].fitness = rng_float(&b->rng) * 1000.0f;
+        }
+        ga_evolve(b->pop, b->pool);
+    }
+}
+
+// A steady-state child's parents and the creatures it competes with must
+// come from different random numbers
+static void check_steady_streams(const Population* pop) {
+    for (uint64_t birth = 0; birth < 64; birth++) {
+        Rng breed, replace;
+        ga_steady_rng(pop, birth, STEADY_BREED, &breed);
+        ga_steady_rng(pop, birth, STEADY_REPLACE, &replace);
+        int same = 0;
+        for (int i = 0; i < 8; i++) same += rng_next(&breed) == rng_next(&replace);
+        if (same == 8) {
+            printf("warning: steady-state breeding and replacement share a random stream\n");
+            return;
+        }
+    }
+}
+
+static void bench_ga(int count, ThreadPool* pool) {
+    static const GenomeFormat formats[] = {GENOME_F32, GENOME_F16, GENOME_I8};
+    static const char* names[] = {"ga_evolve", "ga_evolve_f16", "ga_evolve_i8"};
+    for (int f = 0; f < 3; f++) {
+        GABench b;
+        b.pop = ga_create_population(count, NN_INPUTS, NN_HIDDEN, NN_OUTPUTS, 0.05f, 0.2f, formats[f], 3);
+        b.pool = pool;
+        rng_seed(&b.rng, 3, 1);
+        if (f == 0) check_steady_streams(b.pop);
+        bench_run(names[f], count, "generations/sec", 1, ga_pass, &b);
+        ga_destroy_population(b.pop);
+    }
+}
+
+// --- Novelty search ---
+
+typedef struct {
+    NoveltyArchive* archive;
+    Behavior* batch;
+    float* novelty;
+    ThreadPool* pool;
+} NoveltyBench;
+
+static void novelty_pass(void* ctx, int passes) {
+    NoveltyBench* b = (NoveltyBench*)ctx;
+    for (int pass = 0; pass < passes; pass++) {
+        novelty_score(b->archive, b->batch, NOVELTY_BATCH, NOVELTY_NEIGHBOURS, b->novelty, b->pool);
+    }
+}
+
+static void novelty_brute_pass(void* ctx, int passes) {
+    NoveltyBench* b = (NoveltyBench*)ctx;
+    for (int pass = 0; pass < passes; pass++) {
+        novelty_score_brute(b->archive, b->batch, NOVELTY_BATCH, NOVELTY_NEIGHBOURS, b->novelty);
+    }
+}
+
+// A behavior spread like those of a population: distance walked, lean,
+// and foot contact shares, some of them clones
+static Behavior bench_behavior(Rng* rng, int id) {
+    Behavior b = {{rng_float(rng) * 5.0f, rng_symmetric(rng) * 0.5f, rng_float(rng), rng_float(rng)}, id};
+    return b;
+}
+
+static void bench_novelty(int count, ThreadPool* pool) {
+    Rng rng;
+    rng_seed(&rng, 5, 0);
+    NoveltyBench b;
+    b.archive = novelty_archive_create();
+    b.batch = (Behavior*)malloc(NOVELTY_BATCH * sizeof(Behavior));
+    b.novelty = (float*)malloc(NOVELTY_BATCH * sizeof(float));
+    b.pool = pool;
+
+    // Archived in generation-sized batches, as training adds them
+    Behavior* added = (Behavior*)malloc(NOVELTY_BATCH * sizeof(Behavior));
+    for (int done = 0; done < count;) {
+        int n = count - done < NOVELTY_BATCH ? count - done : NOVELTY_BATCH;
+        for (int i = 0; i < n; i++) added[i] = i % 8 == 7 ? added[i - 1] : bench_behavior(&rng, -1);
+        novelty_archive_add(b.archive, added, n);
+        done += n;
+    }
+    free(added);
+    for (int i = 0; i < NOVELTY_BATCH; i++) b.batch[i] = bench_behavior(&rng, i);
+
+    // The k-d trees must find exactly the neighbours a full scan does
+    if (count <= NOVELTY_BRUTE_MAX) {
+        float* reference = (float*)malloc(NOVELTY_BATCH * sizeof(float));
+        novelty_brute_pass(&b, 1);
+        memcpy(reference, b.novelty, NOVELTY_BATCH * sizeof(float));
+        novelty_pass(&b, 1);
+        if (memcmp(reference, b.novelty, NOVELTY_BATCH * sizeof(float)) != 0) {
+            printf("warning: novelty_score differs from novelty_score_brute\n");
+        }
+        free(reference);
+        bench_run("novelty_brute", count, "queries/sec", NOVELTY_BATCH, novelty_brute_pass, &b);
+    }
+    bench_run("novelty_knn", count, "queries/sec", NOVELTY_BATCH, novelty_pass, &b);
+
+    novelty_archive_destroy(b.archive);
+    free(b.batch);
+    free(b.novelty);
+}
+
+// --- Whole simulation ---
+
+typedef struct {
+    SimulationState* sim;
+} SimBench;
+
+static void generation_pass(void* ctx, int passes) {
+    SimBench* b = (SimBench*)ctx;
+    for (int pass = 0; pass < passes; pass++) {
+        simulation_run_generation(b->sim, 1.0f / 60.0f);
+    }
+}
+
+static void bench_generation(int threads) {
+    SimBench b;
+    SimConfig config;
+    config_defaults(&config);
+    b.sim = simulation_create(&config, 4, threads);
+    b.sim->verbose = 0;
+    bench_run("generation", b.sim->population->population_size, "generations/sec", 1, generation_pass, &b);
+    simulation_destroy(b.sim);
+}
+
+static int write_json(const char* path, const char* label, int threads, float tanh_error) {
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        printf("Could not open %s for writing\n", path);
+        return 0;
+    }
+    fprintf(f, "{\n  \"label\": \"%s\",\n  \"simd_width\": %d,\n  \"threads\": %d,\n", label, SIMD_WIDTH, threads);
+    fprintf(f, "  \"reps\": %d,\n  \"warmup\": %d,\n  \"simd_tanh_max_error\": %g,\n", bench_reps, bench_warmup, tanh_error);
+    fprintf(f, "  \"results\": [\n");
+    for (int i = 0; i < result_count; i++) {
+        BenchResult* r = &results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"size\": %d, \"unit\": \"%s\", \"passes\": %d, "
+                   "\"median\": %.6g, \"p10\": %.6g, \"p90\": %.6g, \"min\": %.6g, \"max\": %.6g, "
+                   "\"ms_per_pass\": %.6g}%s\n",
+                r->name, r->size, r->unit, r->passes, r->median, r->p10, r->p90, r->min, r->max,
+                r->ms_per_pass, i + 1 < result_count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return 1;
+}
+
+static int parse_sizes(const char* text, int* sizes) {
+    int count = 0;
+    while (*text != '\0' && count < MAX_SIZES) {
+        char* end;
+        long size = strtol(text, &end, 10);
+        if (end == text || size <= 0) return 0;
+        sizes[count++] = (int)size;
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return count;
+}
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --sizes N,N,...   Population sizes for the kernel benchmarks (default 64,1024,16384)\n");
+    printf("  --reps N          Timed repetitions per benchmark (default %d)\n", DEFAULT_REPS);
+    printf("  --warmup N        Untimed repetitions first (default %d)\n", DEFAULT_WARMUP);
+    printf("  --threads N       Threads for ga_evolve and whole generations (default 1)\n");
+    printf("  --json PATH       Write results as JSON\n");
+    printf("  --label TEXT      Stored in the JSON, e.g. the commit being measured\n");
+}
+
+int main(int argc, char* argv[]) {
+    int sizes[MAX_SIZES] = {64, 1024, 16384};
+    int size_count = 3;
+    int threads = 1;
+    const char* json_path = NULL;
+    const char* label = "";
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (value == NULL) {
+            printf("Missing value for %s\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--sizes") == 0) {
+            size_count = parse_sizes(value, sizes);
+            if (size_count == 0) {
+                printf("Invalid size list %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--reps") == 0) {
+            bench_reps = atoi(value);
+        } else if (strcmp(arg, "--warmup") == 0) {
+            bench_warmup = atoi(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            threads = atoi(value);
+        } else if (strcmp(arg, "--json") == 0) {
+            json_path = value;
+        } else if (strcmp(arg, "--label") == 0) {
+            label = value;
+        } else {
+            printf("Unknown option %s\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    if (bench_reps <= 0 || bench_warmup < 0 || threads <= 0) {
+        printf("Repetitions and threads must be positive\n");
+        return 1;
+    }
+
+    printf("SIMD width %d, %d threads, %d reps after %d warmup\n", SIMD_WIDTH, threads, bench_reps, bench_warmup);
+    float tanh_error = bench_tanh_error();
+    printf("%-22s %8s %14s %-18s\n", "benchmark", "size", "median", "unit");
+
+    ThreadPool* pool = pool_create(threads);
+    for (int i = 0; i < size_count; i++) {
+        bench_nn(sizes[i]);
+        bench_physics(sizes[i]);
+        bench_ga(sizes[i], pool);
+        bench_novelty(sizes[i], pool);
+    }
+    pool_destroy(pool);
+    bench_generation(threads);
+
+    int ok = 1;
+    if (json_path != NULL) ok = write_json(json_path, label, threads, tanh_error);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+#include "checkpoint.h"
+#include "simd.h"
+#include "mapped_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static size_t genome_block_size(const CheckpointHeader* h) {
+    return (size_t)h->population_size * h->gene_stride * genome_element_size((GenomeFormat)h->genome_format);
+}
+
+// Checks that the header is ours and its blocks fit in `file_size` bytes
+static int header_valid(const CheckpointHeader* h, size_t file_size) {
+    if (h->magic != CHECKPOINT_MAGIC) return 0;
+    if (h->version != CHECKPOINT_VERSION || h->header_size != sizeof(CheckpointHeader)) return 0;
+    if (h->population_size <= 0 || h->gene_count <= 0 || h->gene_stride < h->gene_count) return 0;
+    if (!(h->elite_fraction > 0 && h->elite_fraction <= 1) || !(h->sim_duration > 0)) return 0;
+    if (h->genome_format > GENOME_I8) return 0;
+    if (h->scenario_count <= 0 || h->combine < COMBINE_MEAN || h->combine > COMBINE_QUANTILE) return 0;
+    if (!(h->quantile >= 0 && h->quantile <= 1) || !(h->terrain_height >= 0) || !(h->start_offset >= 0) ||
+        !(h->push_speed >= 0)) {
+        return 0;
+    }
+    if (h->best_index < 0 || h->best_index >= h->population_size || h->history_count < 0) return 0;
+    if (h->genome_offset < sizeof(CheckpointHeader) || h->genome_offset + genome_block_size(h) > file_size) return 0;
+    if (h->history_offset + (uint64_t)h->history_count * sizeof(FitnessRecord) > file_size) return 0;
+    return 1;
+}
+
+static int write_padding(FILE* f, long offset) {
+    static const unsigned char zeros[SIMD_ALIGNMENT];
+    long pos = ftell(f);
+    if (pos < 0 || pos > offset) return 0;
+    return fwrite(zeros, 1, offset - pos, f) == (size_t)(offset - pos);
+}
+
+// Flushes `f` all the way to disk before it is renamed into place
+static int sync_file(FILE* f) {
+    if (fflush(f) != 0) return 0;
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+int checkpoint_save(const SimulationState* state, const char* path) {
+    const Population* pop = state->population;
+
+    CheckpointHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = CHECKPOINT_MAGIC;
+    h.version = CHECKPOINT_VERSION;
+    h.header_size = sizeof(CheckpointHeader);
+    h.seed = pop->seed;
+    h.generation = state->generation;
+    h.ga_generation = pop->generation;
+    h.best_index = pop->best_index;
+    h.elite_threshold = pop->elite_threshold;
+    h.population_size = pop->population_size;
+    h.input_count = pop->input_count;
+    h.hidden_count = pop->hidden_count;
+    h.output_count = pop->output_count;
+    h.gene_count = pop->gene_count;
+    h.gene_stride = pop->gene_stride;
+    h.genome_format = pop->format;
+    h.mutation_rate = pop->mutation_rate;
+    h.mutation_noise = pop->mutation_noise;
+    h.elite_fraction = pop->elite_fraction;
+    h.sim_duration = state->config.sim_duration;
+    h.leg_force = state->config.leg_force;
+    h.arm_force = state->config.arm_force;
+    h.scenario_count = state->config.scenario_count;
+    h.combine = state->config.combine;
+    h.quantile = state->config.quantile;
+    h.terrain_height = state->config.terrain_height;
+    h.start_offset = state->config.start_offset;
+    h.push_speed = state->config.push_speed;
+
+    size_t genome_size = genome_block_size(&h);
+    h.genome_offset = (sizeof(CheckpointHeader) + SIMD_ALIGNMENT - 1) / SIMD_ALIGNMENT * SIMD_ALIGNMENT;
+    h.history_offset = h.genome_offset + genome_size;
+    h.history_count = state->history_count;
+    h.genome_hash = fitness_cache_hash(pop->genes, genome_size, 0);
+
+    size_t tmp_len = strlen(path) + 5;
+    char* tmp_path = (char*)malloc(tmp_len);
+    snprintf(tmp_path, tmp_len, "%s.tmp", path);
+
+    FILE* f = fopen(tmp_path, "wb");
+    if (f == NULL) {
+        printf("Could not open %s for writing\n", tmp_path);
+        free(tmp_path);
+        return 0;
+    }
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    ok = ok && write_padding(f, (long)h.genome_offset);
+    ok = ok && fwrite(pop->genes, 1, genome_size, f) == genome_size;
+    ok = ok && fwrite(state->history, sizeof(FitnessRecord), h.history_count, f) == (size_t)h.history_count;
+    ok = ok && sync_file(f);
+    ok = (fclose(f) == 0) && ok;
+
+#ifdef _WIN32
+    ok = ok && MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    ok = ok && rename(tmp_path, path) == 0;
+#endif
+    if (!ok) {
+        printf("Could not write checkpoint %s\n", path);
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    return ok;
+}
+
+// The run's sizes, rates, gains and scenarios come from the checkpoint,
+// the rest from `config`
+static void apply_header(SimConfig* config, const CheckpointHeader* h) {
+    config->population_size = h->population_size;
+    config->hidden_count = h->hidden_count;
+    config->mutation_rate = h->mutation_rate;
+    config->mutation_noise = (MutationNoise)h->mutation_noise;
+    config->elite_fraction = h->elite_fraction;
+    config->genome_format = (GenomeFormat)h->genome_format;
+    config->sim_duration = h->sim_duration;
+    config->leg_force = h->leg_force;
+    config->arm_force = h->arm_force;
+    config->scenario_count = h->scenario_count;
+    config->combine = (FitnessCombine)h->combine;
+    config->quantile = h->quantile;
+    config->terrain_height = h->terrain_height;
+    config->start_offset = h->start_offset;
+    config->push_speed = h->push_speed;
+}
+
+SimulationState* checkpoint_resume(const char* path, const SimConfig* config, int thread_count) {
+    MappedFile m;
+    if (!mapped_file_open(path, &m)) {
+        printf("Could not map checkpoint %s\n", path);
+        return NULL;
+    }
+
+    CheckpointHeader h;
+    if (m.size < sizeof(h)) {
+        printf("Checkpoint %s is truncated\n", path);
+        mapped_file_close(&m);
+        return NULL;
+    }
+    memcpy(&h, m.data, sizeof(h));
+    if (!header_valid(&h, m.size) || fitness_cache_hash(m.data + h.genome_offset, genome_block_size(&h), 0) != h.genome_hash) {
+        printf("Checkpoint %s is corrupt or from an incompatible version\n", path);
+        mapped_file_close(&m);
+        return NULL;
+    }
+
+    SimConfig run = *config;
+    apply_header(&run, &h);
+    SimulationState* state = simulation_create(&run, h.seed, thread_count);
+    Population* pop = state->population;
+    if (h.gene_stride != pop->gene_stride || h.input_count != pop->input_count || h.output_count != pop->output_count) {
+        printf("Checkpoint %s has %d-%d-%d networks, this build expects %d-%d-%d\n", path,
+               h.input_count, h.hidden_count, h.output_count,
+               pop->input_count, pop->hidden_count, pop->output_count);
+        simulation_destroy(state);
+        mapped_file_close(&m);
+        return NULL;
+    }
+
+    // The genome block has the arena's layout, so it is copied as-is
+    memcpy(pop->genes, m.data + h.genome_offset, genome_block_size(&h));
+    pop->generation = h.ga_generation;
+    pop->best_index = h.best_index;
+    pop->elite_threshold = h.elite_threshold;
+    pop->mutation_rate = h.mutation_rate;
+    pop->mutation_noise = (MutationNoise)h.mutation_noise;
+
+    if (h.history_count > 0) {
+        state->history = (FitnessRecord*)malloc(h.history_count * sizeof(FitnessRecord));
+        memcpy(state->history, m.data + h.history_offset, h.history_count * sizeof(FitnessRecord));
+        state->history_count = h.history_count;
+        state->history_capacity = h.history_count;
+        FitnessRecord* last = &state->history[h.history_count - 1];
+        state->best_fitness = last->best;
+        state->avg_fitness = last->avg;
+        state->worst_fitness = last->worst;
+    }
+    state->generation = h.generation;
+    mapped_file_close(&m);
+
+    simulation_reload(state);
+    return state;
+}
+
+// Reads and validates just the header
+static int read_header(FILE* f, CheckpointHeader* h) {
+    return fread(h, sizeof(*h), 1, f) == 1 && fseek(f, 0, SEEK_END) == 0 && header_valid(h, (size_t)ftell(f));
+}
+
+int checkpoint_read_config(const char* path, SimConfig* config) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("Could not open checkpoint %s\n", path);
+        return 0;
+    }
+    CheckpointHeader h;
+    int ok = read_header(f, &h);
+    fclose(f);
+    if (!ok) {
+        printf("Checkpoint %s is corrupt or from an incompatible version\n", path);
+        return 0;
+    }
+    apply_header(config, &h);
+    return 1;
+}
+
+float* checkpoint_read_best(const char* path, CheckpointHeader* header) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("Could not open checkpoint %s\n", path);
+        return NULL;
+    }
+
+    float* genes = NULL;
+    CheckpointHeader h;
+    if (read_header(f, &h)) {
+        GenomeFormat format = (GenomeFormat)h.genome_format;
+        size_t element = genome_element_size(format);
+        long offset = (long)(h.genome_offset + (uint64_t)h.best_index * h.gene_stride * element);
+        void* stored = malloc(h.gene_count * element);
+        if (fseek(f, offset, SEEK_SET) == 0 && fread(stored, element, h.gene_count, f) == (size_t)h.gene_count) {
+            genes = (float*)malloc(h.gene_count * sizeof(float));
+            for (int i = 0; i < h.gene_count; i++) genes[i] = genome_get(format, stored, i);
+        }
+        free(stored);
+    }
+    fclose(f);
+
+    if (genes == NULL) {
+        printf("Checkpoint %s is corrupt or from an incompatible version\n", path);
+        return NULL;
+    }
+    if (header != NULL) *header = h;
+    return genes;
+}
@@ -0,0 +1,74 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "simulation.h"
+#include <stdint.h>
+
+#define CHECKPOINT_MAGIC 0x54504B434B4C4157ULL // "WALKCKPT"
+#define CHECKPOINT_VERSION 3
+
+// Fixed-size header at the start of a checkpoint file. Values are stored
+// in native byte order. The genome block is the population's arena as-is
+// (population_size * gene_stride genome elements, padding included) so resuming
+// is a single copy; the fitness history follows it.
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+
+    // Run state. Every random draw is keyed by (seed, ga_generation), so
+    // these are the whole RNG state.
+    uint64_t seed;
+    int32_t generation;    // Next generation to simulate
+    int32_t ga_generation; // Population.generation
+    int32_t best_index;
+    float elite_threshold;
+
+    // Hyperparameters
+    int32_t population_size;
+    int32_t input_count;
+    int32_t hidden_count;
+    int32_t output_count;
+    int32_t gene_count;
+    int32_t gene_stride;
+    float mutation_rate;
+    int32_t mutation_noise;
+    float elite_fraction;
+    float sim_duration; // Seconds per evaluation
+    float leg_force;
+    float arm_force;
+
+    // Scenarios, as in SimConfig
+    int32_t scenario_count;
+    int32_t combine; // FitnessCombine
+    float quantile;
+    float terrain_height;
+    float start_offset;
+    float push_speed;
+
+    // Blocks, as byte offsets from the start of the file
+    uint64_t genome_offset; // Aligned to SIMD_ALIGNMENT
+    uint64_t history_offset;
+    int32_t history_count;  // FitnessRecords
+    uint32_t genome_format; // GenomeFormat of the genome block
+    uint64_t genome_hash;   // fitness_cache_hash of the genome block
+} CheckpointHeader;
+
+// Writes `state` to a temporary file next to `path`, then renames it over
+// `path`, so a crash never leaves a partial checkpoint. Returns 1 on success.
+int checkpoint_save(const SimulationState* state, const char* path);
+// Maps `path` and continues the run it holds in a new simulation. The
+// population size, hidden layer, mutation rate, elite fraction, genome
+// format, evaluation duration, force gains and scenario settings are the
+// checkpoint's; everything else in `config` applies. Returns NULL if the file is
+// missing, corrupt or from an incompatible build.
+SimulationState* checkpoint_resume(const char* path, const SimConfig* config, int thread_count);
+// Overwrites the sizes, rates, gains and scenarios in `config` with the checkpoint's, e.g.
+// to check the memory budget before resuming. Returns 0 on error.
+int checkpoint_read_config(const char* path, SimConfig* config);
+// Reads only the header and the best creature's genome, for playback.
+// Returns gene_count malloc'd floats, widened from the stored format, or
+// NULL on error.
+float* checkpoint_read_best(const char* path, CheckpointHeader* header);
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,201 @@
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#define CONFIG_LINE_MAX 1024
+
+typedef enum {
+    KEY_INT,
+    KEY_FLOAT,
+    KEY_DOUBLE,
+    KEY_FORMAT, // A GenomeFormat by name
+    KEY_COMBINE, // A FitnessCombine by name
+    KEY_NOISE    // A MutationNoise by name
+} KeyType;
+
+typedef struct {
+    const char* name;
+    KeyType type;
+    size_t offset;
+    int positive; // Must be > 0; otherwise >= 0
+    double max;   // Largest allowed value, 0 for no limit
+} ConfigKey;
+
+static const ConfigKey config_keys[] = {
+    {"population", KEY_INT, offsetof(SimConfig, population_size), 1},
+    {"hidden", KEY_INT, offsetof(SimConfig, hidden_count), 1},
+    {"mutation-rate", KEY_FLOAT, offsetof(SimConfig, mutation_rate), 0},
+    {"mutation-noise", KEY_NOISE, offsetof(SimConfig, mutation_noise), 0},
+    {"elite-fraction", KEY_FLOAT, offsetof(SimConfig, elite_fraction), 1, 1},
+    {"duration", KEY_FLOAT, offsetof(SimConfig, sim_duration), 1},
+    {"chunk", KEY_INT, offsetof(SimConfig, chunk_size), 0},
+    {"memory-budget", KEY_DOUBLE, offsetof(SimConfig, memory_budget_mb), 0},
+    {"genome", KEY_FORMAT, offsetof(SimConfig, genome_format), 0},
+    {"leg-force", KEY_FLOAT, offsetof(SimConfig, leg_force), 0},
+    {"arm-force", KEY_FLOAT, offsetof(SimConfig, arm_force), 0},
+    {"scenarios", KEY_INT, offsetof(SimConfig, scenario_count), 1},
+    {"combine", KEY_COMBINE, offsetof(SimConfig, combine), 0},
+    {"quantile", KEY_FLOAT, offsetof(SimConfig, quantile), 0, 1},
+    {"terrain", KEY_FLOAT, offsetof(SimConfig, terrain_height), 0},
+    {"start-offset", KEY_FLOAT, offsetof(SimConfig, start_offset), 0},
+    {"push", KEY_FLOAT, offsetof(SimConfig, push_speed), 0},
+};
+
+#define CONFIG_KEY_COUNT (int)(sizeof(config_keys) / sizeof(config_keys[0]))
+
+void config_defaults(SimConfig* config) {
+    config->population_size = DEFAULT_POPULATION_SIZE;
+    config->hidden_count = DEFAULT_NN_HIDDEN;
+    config->mutation_rate = DEFAULT_MUTATION_RATE;
+    config->mutation_noise = MUTATION_UNIFORM;
+    config->elite_fraction = DEFAULT_ELITE_FRACTION;
+    config->sim_duration = DEFAULT_SIM_DURATION;
+    config->chunk_size = 0;
+    config->memory_budget_mb = 0;
+    config->genome_format = GENOME_F32;
+    config->leg_force = DEFAULT_LEG_FORCE;
+    config->arm_force = DEFAULT_ARM_FORCE;
+    config->scenario_count = 1;
+    config->combine = COMBINE_MEAN;
+    config->quantile = DEFAULT_QUANTILE;
+    config->terrain_height = 0;
+    config->start_offset = 0;
+    config->push_speed = 0;
+}
+
+const char* config_combine_name(FitnessCombine combine) {
+    switch (combine) {
+    case COMBINE_MEAN: return "mean";
+    case COMBINE_MIN: return "min";
+    case COMBINE_QUANTILE: return "quantile";
+    }
+    return "?";
+}
+
+static const ConfigKey* find_key(const char* name) {
+    for (int i = 0; i < CONFIG_KEY_COUNT; i++) {
+        if (strcmp(config_keys[i].name, name) == 0) return &config_keys[i];
+    }
+    return NULL;
+}
+
+int config_has_key(const char* key) {
+    return find_key(key) != NULL;
+}
+
+int config_set(SimConfig* config, const char* key, const char* value) {
+    const ConfigKey* k = find_key(key);
+    if (k == NULL) {
+        printf("Unknown config key %s\n", key);
+        return 0;
+    }
+
+    char* field = (char*)config + k->offset;
+    if (k->type == KEY_FORMAT) {
+        const GenomeFormat formats[] = {GENOME_F32, GENOME_F16, GENOME_I8};
+        for (int i = 0; i < 3; i++) {
+            if (strcmp(value, genome_format_name(formats[i])) == 0) {
+                *(GenomeFormat*)field = formats[i];
+                return 1;
+            }
+        }
+        printf("Bad value '%s' for %s (expected f32, f16 or i8)\n", value, key);
+        return 0;
+    }
+    if (k->type == KEY_NOISE) {
+        const MutationNoise kinds[] = {MUTATION_UNIFORM, MUTATION_GAUSSIAN};
+        for (int i = 0; i < 2; i++) {
+            if (strcmp(value, ga_mutation_noise_name(kinds[i])) == 0) {
+                *(MutationNoise*)field = kinds[i];
+                return 1;
+            }
+        }
+        printf("Bad value '%s' for %s (expected uniform or gaussian)\n", value, key);
+        return 0;
+    }
+    if (k->type == KEY_COMBINE) {
+        const FitnessCombine modes[] = {COMBINE_MEAN, COMBINE_MIN, COMBINE_QUANTILE};
+        for (int i = 0; i < 3; i++) {
+            if (strcmp(value, config_combine_name(modes[i])) == 0) {
+                *(FitnessCombine*)field = modes[i];
+                return 1;
+            }
+        }
+        printf("Bad value '%s' for %s (expected mean, min or quantile)\n", value, key);
+        return 0;
+    }
+
+    char* end;
+    double v = strtod(value, &end);
+    while (isspace((unsigned char)*end)) end++;
+    int valid = end != value && *end == '\0' && (k->positive ? v > 0 : v >= 0) && (k->max == 0 || v <= k->max);
+    // Range first: converting an out-of-range double to int is undefined
+    if (k->type == KEY_INT) valid = valid && v <= INT_MAX && v == (int)v;
+    if (!valid) {
+        printf("Bad value '%s' for %s\n", value, key);
+        return 0;
+    }
+
+    switch (k->type) {
+    case KEY_INT: *(int*)field = (int)v; break;
+    case KEY_FLOAT: *(float*)field = (float)v; break;
+    case KEY_DOUBLE: *(double*)field = v; break;
+    case KEY_FORMAT:
+    case KEY_COMBINE:
+    case KEY_NOISE: break;
+    }
+    return 1;
+}
+
+char* config_trim(char* s) {
+    while (isspace((unsigned char)*s)) s++;
+    char* end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+static int set_line(const char* key, char* value, void* ctx) {
+    return config_set((SimConfig*)ctx, key, value);
+}
+
+int config_load(SimConfig* config, const char* path) {
+    return config_parse_file(path, "config", set_line, config);
+}
+
+int config_parse_file(const char* path, const char* kind, ConfigLineFn fn, void* ctx) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        printf("Could not open %s %s\n", kind, path);
+        return 0;
+    }
+
+    char line[CONFIG_LINE_MAX];
+    int line_number = 0;
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), f) != NULL) {
+        line_number++;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+        char* text = config_trim(line);
+        if (*text == '\0') continue;
+
+        char* equals = strchr(text, '=');
+        if (equals == NULL) {
+            printf("%s:%d: expected key = value\n", path, line_number);
+            ok = 0;
+            break;
+        }
+        *equals = '\0';
+        if (!fn(config_trim(text), config_trim(equals + 1), ctx)) {
+            printf("  at %s:%d\n", path, line_number);
+            ok = 0;
+        }
+    }
+    fclose(f);
+    return ok;
+}
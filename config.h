@@ -0,0 +1,68 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "genetics.h"
+
+#define DEFAULT_POPULATION_SIZE 50
+#define DEFAULT_NN_HIDDEN 16
+#define DEFAULT_MUTATION_RATE 0.05f
+#define DEFAULT_ELITE_FRACTION 0.2f
+#define DEFAULT_SIM_DURATION 10.0f // seconds
+#define DEFAULT_QUANTILE 0.25f
+#define DEFAULT_LEG_FORCE 2000.0f
+#define DEFAULT_ARM_FORCE 1000.0f
+
+// How the fitness of a genome's scenarios becomes its score
+typedef enum {
+    COMBINE_MEAN,
+    COMBINE_MIN,
+    COMBINE_QUANTILE // The `quantile` quantile, interpolated between scenarios
+} FitnessCombine;
+
+// Sizes and rates of a training run, read at startup. Every allocation
+// of the simulation is sized from these.
+typedef struct {
+    int population_size;
+    int hidden_count;        // Hidden neurons per controller
+    float mutation_rate;
+    MutationNoise mutation_noise; // Of the ga's mutations
+    float elite_fraction;    // Share of the population ga_evolve keeps unchanged
+    float sim_duration;      // Seconds each creature is simulated per generation
+    int chunk_size;          // Creatures simulated at once; 0 for the whole population
+    double memory_budget_mb; // 0 for no limit
+    GenomeFormat genome_format; // Storage of genomes and controller weights
+    float leg_force;         // Force at full controller output on each ankle...
+    float arm_force;         // ...and each hand
+
+    // Each genome is evaluated in scenario_count scenarios at once. The
+    // first is the flat ground and fixed start; the others draw their
+    // terrain, start and push within these limits.
+    int scenario_count;
+    FitnessCombine combine;
+    float quantile;       // For COMBINE_QUANTILE, in [0, 1]
+    float terrain_height; // Largest rise or dip of the ground (px)
+    float start_offset;   // Largest shift of the start position along x (px)
+    float push_speed;     // Largest sideways push, once per evaluation (px/s)
+} SimConfig;
+
+void config_defaults(SimConfig* config);
+const char* config_combine_name(FitnessCombine combine);
+// Sets one key; keys are named like their command line flags without
+// the dashes, e.g. "population" for --population. Prints and returns 0
+// for an unknown key or a bad value.
+int config_set(SimConfig* config, const char* key, const char* value);
+// Nonzero if `key` names a config key
+int config_has_key(const char* key);
+// Reads "key = value" lines; '#' starts a comment. Returns 0 on error.
+int config_load(SimConfig* config, const char* path);
+
+// Handles one line of a "key = value" file, both trimmed. Prints and
+// returns 0 for a bad line.
+typedef int (*ConfigLineFn)(const char* key, char* value, void* ctx);
+// Calls `fn` on each line of a file in the config syntax, stopping at the
+// first bad one. `kind` names the file in errors. Returns 0 on error.
+int config_parse_file(const char* path, const char* kind, ConfigLineFn fn, void* ctx);
+// Strips leading and trailing whitespace in place
+char* config_trim(char* s);
+
+#endif // CONFIG_H
@@ -0,0 +1,94 @@
+#include "fitness_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int cache_capacity(int min_capacity) {
+    int capacity = 64;
+    while (capacity < min_capacity) capacity *= 2;
+    return capacity;
+}
+
+size_t fitness_cache_bytes(int min_capacity) {
+    return sizeof(FitnessCache) + (size_t)cache_capacity(min_capacity) * (sizeof(uint64_t) + sizeof(float));
+}
+
+FitnessCache* fitness_cache_create(int min_capacity) {
+    FitnessCache* cache = (FitnessCache*)malloc(sizeof(FitnessCache));
+    int capacity = cache_capacity(min_capacity);
+    cache->capacity = capacity;
+    cache->count = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->keys = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+    cache->values = (float*)malloc(capacity * sizeof(float));
+    return cache;
+}
+
+void fitness_cache_destroy(FitnessCache* cache) {
+    free(cache->keys);
+    free(cache->values);
+    free(cache);
+}
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Word-at-a-time multiply-rotate hash with a murmur finalizer
+uint64_t fitness_cache_hash(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t h = seed ^ (size * 0x9E3779B97F4A7C15ULL);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        h ^= word * 0x87c37b91114253d5ULL;
+        h = (h << 31) | (h >> 33);
+        h *= 0x4cf5ad432745937fULL;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    h ^= tail;
+    h = mix64(h);
+    return h == 0 ? 1 : h;
+}
+
+static int find_slot(const FitnessCache* cache, uint64_t key) {
+    int mask = cache->capacity - 1;
+    int slot = (int)(key & mask);
+    while (cache->keys[slot] != 0 && cache->keys[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+int fitness_cache_lookup(FitnessCache* cache, uint64_t key, float* fitness) {
+    int slot = find_slot(cache, key);
+    if (cache->keys[slot] == key) {
+        *fitness = cache->values[slot];
+        cache->hits++;
+        return 1;
+    }
+    cache->misses++;
+    return 0;
+}
+
+void fitness_cache_store(FitnessCache* cache, uint64_t key, float fitness) {
+    // Keep the load factor under 3/4 by starting over; entries only
+    // matter for as long as their genomes survive, which is short.
+    if (cache->count >= cache->capacity / 4 * 3) {
+        memset(cache->keys, 0, cache->capacity * sizeof(uint64_t));
+        cache->count = 0;
+    }
+    int slot = find_slot(cache, key);
+    if (cache->keys[slot] != key) {
+        cache->keys[slot] = key;
+        cache->count++;
+    }
+    cache->values[slot] = fitness;
+}
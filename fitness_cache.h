@@ -0,0 +1,29 @@
+#ifndef FITNESS_CACHE_H
+#define FITNESS_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Open-addressing table from a 64-bit content hash (genome bytes plus
+// simulation parameters) to the fitness that genome earned. Evaluation is
+// deterministic, so an identical key never needs simulating again.
+typedef struct {
+    uint64_t* keys; // 0 marks an empty slot
+    float* values;
+    int capacity;   // Power of two
+    int count;
+
+    long long hits;
+    long long misses;
+} FitnessCache;
+
+FitnessCache* fitness_cache_create(int min_capacity);
+void fitness_cache_destroy(FitnessCache* cache);
+// Memory fitness_cache_create(min_capacity) will allocate
+size_t fitness_cache_bytes(int min_capacity);
+uint64_t fitness_cache_hash(const void* data, size_t size, uint64_t seed);
+// Returns 1 and sets *fitness on a hit; updates the hit/miss counters
+int fitness_cache_lookup(FitnessCache* cache, uint64_t key, float* fitness);
+void fitness_cache_store(FitnessCache* cache, uint64_t key, float fitness);
+
+#endif // FITNESS_CACHE_H
@@ -1,85 +1,345 @@
 #include "genetics.h"
+#include "profile.h"
+#include "simd.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 
-// Helper to sort creatures by fitness (descending)
-static int compare_creatures(const void* a, const void* b) {
-    float fitness_a = ((Creature*)a)->fitness;
-    float fitness_b = ((Creature*)b)->fitness;
-    if (fitness_a < fitness_b) return 1;
-    if (fitness_a > fitness_b) return -1;
-    return 0;
+#define MUTATION_STEP 0.1f
+#define BREED_CHUNK 256 // Children per parallel task
+#define STEADY_SEED_SALT 0x9E3779B97F4A7C15ULL // Keeps steady-state streams apart from generational ones
+#define STEADY_REPLACE_SALT 0xC2B2AE3D27D4EB4FULL // Keeps replacement draws apart from breeding ones
+#define STEADY_TOURNAMENT 4 // Creatures drawn to find the one a steady-state child replaces
+
+// Hoare quickselect, average O(n)
+void ga_select_top(CreatureRank* ranks, int n, int k) {
+    int target = k - 1;
+    int lo = 0, hi = n - 1;
+    while (lo < hi) {
+        float a = ranks[lo].fitness, b = ranks[lo + (hi - lo) / 2].fitness, c = ranks[hi].fitness;
+        float pivot = (a < b) ? ((b < c) ? b : (a < c ? c : a)) : ((a < c) ? a : (b < c ? c : b));
+
+        int i = lo, j = hi;
+        while (i <= j) {
+            while (ranks[i].fitness > pivot) i++;
+            while (ranks[j].fitness < pivot) j--;
+            if (i <= j) {
+                CreatureRank swap = ranks[i];
+                ranks[i] = ranks[j];
+                ranks[j] = swap;
+                i++;
+                j--;
+            }
+        }
+        if (target <= j) hi = j;
+        else if (target >= i) lo = i;
+        else break;
+    }
+}
+
+// lowbias32 integer hash, used as a counter-based generator for noise
+static inline uint32_t noise_hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline float noise_unit(uint32_t key, uint32_t counter) {
+    return (noise_hash(key + counter * 0x9E3779B9U) >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+void ga_noise(MutationNoise kind, uint32_t key, float* out, int count) {
+    if (kind == MUTATION_GAUSSIAN) {
+        // Irwin-Hall: the sum of four uniforms, scaled to unit variance
+        const float scale = 0.8660254f; // sqrt(3/4)
+        for (int k = 0; k < count; k += GA_NOISE_BLOCK) {
+            for (int l = 0; l < GA_NOISE_BLOCK; l++) {
+                uint32_t c = (uint32_t)(k + l) * 4;
+                out[k + l] = (noise_unit(key, c) + noise_unit(key, c + 1) +
+                              noise_unit(key, c + 2) + noise_unit(key, c + 3)) * scale;
+            }
+        }
+    } else {
+        for (int k = 0; k < count; k += GA_NOISE_BLOCK) {
+            for (int l = 0; l < GA_NOISE_BLOCK; l++) {
+                out[k + l] = noise_unit(key, (uint32_t)(k + l));
+            }
+        }
+    }
+}
+
+// Random stream for creature `index` in `generation`
+static void creature_rng(const Population* pop, int generation, int index, Rng* rng) {
+    rng_seed(rng, pop->seed, ((uint64_t)generation << 32) | (uint32_t)index);
+}
+
+static size_t genome_bytes(const Population* pop, int genes) {
+    return (size_t)genes * genome_element_size(pop->format);
 }
 
-Population* ga_create_population(int size, int nn_inputs, int nn_hidden, int nn_outputs, float mutation_rate) {
+Population* ga_create_population(int size, int nn_inputs, int nn_hidden, int nn_outputs, float mutation_rate,
+                                 float elite_fraction, GenomeFormat format, uint64_t seed) {
     Population* pop = (Population*)malloc(sizeof(Population));
     pop->population_size = size;
+    pop->input_count = nn_inputs;
+    pop->hidden_count = nn_hidden;
+    pop->output_count = nn_outputs;
     pop->gene_count = nn_inputs * nn_hidden + nn_hidden * nn_outputs;
+    pop->format = format;
+    pop->gene_stride = ga_gene_stride(pop->gene_count, format);
     pop->mutation_rate = mutation_rate;
+    pop->elite_fraction = elite_fraction;
+    pop->mutation_noise = MUTATION_UNIFORM;
+    pop->best_index = 0;
+    pop->elite_threshold = 0;
+    pop->seed = seed;
+    pop->generation = 0;
+
+    // Every allocation the GA will ever need is made here
+    size_t arena_size = (size_t)size * genome_bytes(pop, pop->gene_stride);
+    pop->genes = simd_alloc(arena_size);
+    pop->next_genes = simd_alloc(arena_size);
     pop->creatures = (Creature*)malloc(size * sizeof(Creature));
+    pop->ranks = (CreatureRank*)malloc(size * sizeof(CreatureRank));
 
+    // Same draws as nn_randomize(), rounded to the storage format
     for (int i = 0; i < size; i++) {
-        pop->creatures[i].nn = nn_create(nn_inputs, nn_hidden, nn_outputs);
+        Rng rng;
+        creature_rng(pop, 0, i, &rng);
+        void* genes = ga_genome(pop, i);
+        for (int j = 0; j < pop->gene_count; j++) genome_set(format, genes, j, rng_symmetric(&rng));
         pop->creatures[i].fitness = 0;
     }
     return pop;
 }
 
 void ga_destroy_population(Population* pop) {
-    for (int i = 0; i < pop->population_size; i++) {
-        nn_destroy(pop->creatures[i].nn);
-    }
+    simd_free(pop->genes);
+    simd_free(pop->next_genes);
     free(pop->creatures);
+    free(pop->ranks);
     free(pop);
 }
 
-void ga_evolve(Population* pop) {
-    // Sort by fitness
-    qsort(pop->creatures, pop->population_size, sizeof(Creature), compare_creatures);
+void ga_decode_genome(const Population* pop, int index, float* out) {
+    const void* genes = ga_genome(pop, index);
+    for (int i = 0; i < pop->gene_count; i++) out[i] = genome_get(pop->format, genes, i);
+}
 
-    // Elitism: Keep the top 20%
-    int elite_count = pop->population_size * 0.2;
-    if (elite_count == 0 && pop->population_size > 0) elite_count = 1;
-    
-    float* new_weights_pop = (float*)malloc(pop->population_size * pop->gene_count * sizeof(float));
-
-    // Crossover
-    for (int i = elite_count; i < pop->population_size; i++) {
-        Creature* parent1 = &pop->creatures[rand() % elite_count];
-        Creature* parent2 = &pop->creatures[rand() % elite_count];
-        
-        float* parent1_genes = (float*)malloc(pop->gene_count * sizeof(float));
-        float* parent2_genes = (float*)malloc(pop->gene_count * sizeof(float));
-        nn_get_weights_flat(parent1->nn, parent1_genes);
-        nn_get_weights_flat(parent2->nn, parent2_genes);
-        
-        int crossover_point = rand() % pop->gene_count;
-        float* child_genes = &new_weights_pop[i * pop->gene_count];
-
-        memcpy(child_genes, parent1_genes, crossover_point * sizeof(float));
-        memcpy(&child_genes[crossover_point], &parent2_genes[crossover_point], (pop->gene_count - crossover_point) * sizeof(float));
-
-        free(parent1_genes);
-        free(parent2_genes);
-    }
-    
-    // Mutation
-    for (int i = elite_count; i < pop->population_size; i++) {
-        for (int j = 0; j < pop->gene_count; j++) {
-            if ((float)rand() / RAND_MAX < pop->mutation_rate) {
-                new_weights_pop[i * pop->gene_count + j] += (((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f) * 0.1f;
-            }
+float ga_diversity(const Population* pop) {
+    int n = pop->gene_count;
+    int size = pop->population_size;
+    if (size < 2) return 0;
+    double* sum = (double*)calloc(2 * n, sizeof(double));
+    double* square_sum = sum + n;
+    float* genes = (float*)malloc(n * sizeof(float));
+    for (int i = 0; i < size; i++) {
+        ga_decode_genome(pop, i, genes);
+        for (int j = 0; j < n; j++) {
+            sum[j] += genes[j];
+            square_sum[j] += (double)genes[j] * genes[j];
+        }
+    }
+    double total = 0;
+    for (int j = 0; j < n; j++) {
+        double mean = sum[j] / size;
+        double variance = square_sum[j] / size - mean * mean;
+        total += variance > 0 ? sqrt(variance) : 0;
+    }
+    free(sum);
+    free(genes);
+    return (float)(total / n);
+}
+
+// Distance to the next mutated gene: geometric with success probability
+// mutation_rate, so only mutated genes cost a random draw
+static int geometric_skip(Rng* rng, float log_keep, int limit) {
+    float skip = logf(1.0f - rng_float(rng)) / log_keep;
+    return skip < (float)limit ? (int)skip : limit;
+}
+
+int ga_elite_count(int size, float fraction) {
+    int count = size * (double)fraction;
+    return (count == 0 && size > 0) ? 1 : count;
+}
+
+// Crossover of two parents drawn from pop->ranks[0, elite_count), then
+// mutation, into `child_genes`. `sites` and `noise` are scratch of
+// gene_count and gene_count + GA_NOISE_BLOCK entries.
+static void breed(const Population* pop, int elite_count, float log_keep, Rng* rng, unsigned char* child_genes,
+                  int* sites, float* noise) {
+    int gene_count = pop->gene_count;
+    const unsigned char* parent1_genes = ga_genome(pop, pop->ranks[rng_int(rng, elite_count)].index);
+    const unsigned char* parent2_genes = ga_genome(pop, pop->ranks[rng_int(rng, elite_count)].index);
+
+    // Crossover copies stored codes, so it is exact in every format
+    int crossover_point = rng_int(rng, gene_count);
+    size_t split = genome_bytes(pop, crossover_point);
+
+    memcpy(child_genes, parent1_genes, split);
+    memcpy(child_genes + split, parent2_genes + split, genome_bytes(pop, gene_count - crossover_point));
+
+    // Collect mutation sites, then draw all their noise in one batch
+    int count = 0;
+    if (pop->mutation_rate >= 1.0f) {
+        for (int j = 0; j < gene_count; j++) sites[count++] = j;
+    } else if (pop->mutation_rate > 0.0f) {
+        int j = geometric_skip(rng, log_keep, gene_count);
+        while (j < gene_count) {
+            sites[count++] = j;
+            j += 1 + geometric_skip(rng, log_keep, gene_count);
         }
     }
+    ga_noise(pop->mutation_noise, rng_next(rng), noise, count);
+    // Compact formats widen, perturb and round back only the mutated genes
+    switch (pop->format) {
+    case GENOME_F16: {
+        uint16_t* genes = (uint16_t*)child_genes;
+        for (int k = 0; k < count; k++) {
+            genes[sites[k]] = genome_f16_encode(genome_f16_decode(genes[sites[k]]) + noise[k] * MUTATION_STEP);
+        }
+        break;
+    }
+    case GENOME_I8: {
+        int8_t* genes = (int8_t*)child_genes;
+        for (int k = 0; k < count; k++) {
+            genes[sites[k]] = genome_i8_encode(genome_i8_decode(genes[sites[k]]) + noise[k] * MUTATION_STEP);
+        }
+        break;
+    }
+    default: {
+        float* genes = (float*)child_genes;
+        for (int k = 0; k < count; k++) genes[sites[k]] += noise[k] * MUTATION_STEP;
+        break;
+    }
+    }
+}
+
+typedef struct {
+    Population* pop;
+    int elite_count;
+    float log_keep; // log(1 - mutation_rate)
+} BreedTask;
+
+static void breed_child(BreedTask* t, int i, int* sites, float* noise) {
+    Population* pop = t->pop;
+    Rng rng;
+    creature_rng(pop, pop->generation, i, &rng);
+    unsigned char* child_genes = (unsigned char*)pop->next_genes + (size_t)i * genome_bytes(pop, pop->gene_stride);
+    breed(pop, t->elite_count, t->log_keep, &rng, child_genes, sites, noise);
+}
 
-    // Apply new weights and reset fitness
-    for(int i = 0; i < pop->population_size; i++) {
-        if (i >= elite_count) {
-            nn_set_weights(pop->creatures[i].nn, &new_weights_pop[i * pop->gene_count]);
+static void breed_task(void* ctx, int task, int thread) {
+    BreedTask* t = (BreedTask*)ctx;
+    Population* pop = t->pop;
+    int sites[pop->gene_count];
+    float noise[pop->gene_count + GA_NOISE_BLOCK];
+
+    int begin = task * BREED_CHUNK;
+    int end = begin + BREED_CHUNK;
+    if (end > pop->population_size) end = pop->population_size;
+    PROFILE_BEGIN(PROF_BREED);
+
+    for (int i = begin; i < end; i++) {
+        if (i < t->elite_count) {
+            // Elites are copied unchanged to the front of the next buffer
+            memcpy((unsigned char*)pop->next_genes + (size_t)i * genome_bytes(pop, pop->gene_stride),
+                   ga_genome(pop, pop->ranks[i].index), genome_bytes(pop, pop->gene_count));
+        } else {
+            breed_child(t, i, sites, noise);
         }
+    }
+    PROFILE_END(PROF_BREED, end - begin);
+}
+
+// Ranks creature fitness and moves the elite_count fittest to the front of
+// pop->ranks, the best first, in O(n) without moving any genomes
+static void select_elites(Population* pop, int elite_count) {
+    int size = pop->population_size;
+    PROFILE_BEGIN(PROF_SELECT);
+    int best = 0;
+    for (int i = 0; i < size; i++) {
+        pop->ranks[i].fitness = pop->creatures[i].fitness;
+        pop->ranks[i].index = i;
+        if (pop->ranks[i].fitness > pop->ranks[best].fitness) best = i;
+    }
+    CreatureRank best_rank = pop->ranks[best];
+    pop->ranks[best] = pop->ranks[0];
+    pop->ranks[0] = best_rank;
+    if (elite_count > 1) ga_select_top(pop->ranks + 1, size - 1, elite_count - 1);
+
+    pop->elite_threshold = pop->ranks[0].fitness;
+    for (int i = 1; i < elite_count; i++) {
+        if (pop->ranks[i].fitness < pop->elite_threshold) pop->elite_threshold = pop->ranks[i].fitness;
+    }
+    PROFILE_END(PROF_SELECT, size);
+}
+
+void ga_evolve(Population* pop, ThreadPool* pool) {
+    int size = pop->population_size;
+
+    // Elitism: Keep the top 20%
+    int elite_count = ga_elite_count(size, pop->elite_fraction);
+    select_elites(pop, elite_count);
+
+    pop->best_index = 0;
+    pop->generation++;
+
+    // Crossover and mutation, written straight into the next buffer. Each
+    // child draws from its own stream, so any split across threads gives
+    // the same children.
+    BreedTask task = {pop, elite_count, logf(1.0f - pop->mutation_rate)};
+    int chunks = (size + BREED_CHUNK - 1) / BREED_CHUNK;
+    if (pool != NULL) {
+        pool_run(pool, chunks, breed_task, &task);
+    } else {
+        for (int i = 0; i < chunks; i++) breed_task(&task, i, 0);
+    }
+
+    // Swap buffers and reset fitness
+    void* swap = pop->genes;
+    pop->genes = pop->next_genes;
+    pop->next_genes = swap;
+
+    for (int i = 0; i < size; i++) {
         pop->creatures[i].fitness = 0;
     }
-    
-    free(new_weights_pop);
+}
+
+void ga_steady_rng(const Population* pop, uint64_t birth, SteadyDraw draw, Rng* rng) {
+    uint64_t salt = draw == STEADY_REPLACE ? STEADY_SEED_SALT ^ STEADY_REPLACE_SALT : STEADY_SEED_SALT;
+    rng_seed(rng, pop->seed ^ salt, birth);
+}
+
+void ga_rank_elites(Population* pop) {
+    select_elites(pop, ga_elite_count(pop->population_size, pop->elite_fraction));
+    pop->best_index = pop->ranks[0].index;
+}
+
+void ga_breed_child(const Population* pop, uint64_t birth, void* child_genes) {
+    int sites[pop->gene_count];
+    float noise[pop->gene_count + GA_NOISE_BLOCK];
+    Rng rng;
+    ga_steady_rng(pop, birth, STEADY_BREED, &rng);
+    breed(pop, ga_elite_count(pop->population_size, pop->elite_fraction), logf(1.0f - pop->mutation_rate), &rng,
+          (unsigned char*)child_genes, sites, noise);
+}
+
+int ga_replace_poor(Population* pop, const void* child_genes, float fitness, uint64_t birth) {
+    Rng rng;
+    ga_steady_rng(pop, birth, STEADY_REPLACE, &rng);
+    int poorest = rng_int(&rng, pop->population_size);
+    for (int i = 1; i < STEADY_TOURNAMENT; i++) {
+        int index = rng_int(&rng, pop->population_size);
+        if (pop->creatures[index].fitness < pop->creatures[poorest].fitness) poorest = index;
+    }
+    // Only a fitter child gets in, so the best creature is never lost
+    if (fitness <= pop->creatures[poorest].fitness) return -1;
+    memcpy(ga_genome(pop, poorest), child_genes, genome_bytes(pop, pop->gene_count));
+    pop->creatures[poorest].fitness = fitness;
+    return poorest;
 }
@@ -2,21 +2,125 @@
 #define GENETICS_H
 
 #include "nn.h"
+#include "threadpool.h"
 
 typedef struct {
-    NeuralNetwork* nn;
     float fitness;
 } Creature;
 
+typedef struct {
+    float fitness;
+    int index;
+} CreatureRank;
+
+typedef enum {
+    MUTATION_UNIFORM,  // Uniform in [-0.1, 0.1)
+    MUTATION_GAUSSIAN  // Approximately normal with sigma 0.1
+} MutationNoise;
+
+static inline const char* ga_mutation_noise_name(MutationNoise noise) {
+    return noise == MUTATION_GAUSSIAN ? "gaussian" : "uniform";
+}
+
+// Noise is generated in fixed blocks so the loops vectorize
+#define GA_NOISE_BLOCK 8
+
+// Genomes are padded to a whole number of cache lines
+#define GENOME_ALIGN_BYTES 64
+
+// All genomes live in one aligned arena of population_size * gene_stride
+// elements in `format`. A genome holds the weights of one controller in
+// nn_get_weights_flat() order; ga_evolve breeds into `next_genes` and then
+// swaps the two, so no memory is allocated after ga_create_population.
 typedef struct {
     Creature* creatures;
+    void* genes;
+    void* next_genes;
+    CreatureRank* ranks;
+
     int population_size;
+    int input_count;
+    int hidden_count;
+    int output_count;
     int gene_count;
+    int gene_stride;
+    GenomeFormat format;
     float mutation_rate;
+    float elite_fraction; // Share of the population kept unchanged by ga_evolve
+    MutationNoise mutation_noise;
+    int best_index; // Best creature of the last evaluated generation (kept by elitism)
+    float elite_threshold; // Lowest fitness that made the elite set last generation
+
+    // Every random draw comes from a stream keyed by (seed, generation,
+    // creature), so results do not depend on evaluation order or threads
+    uint64_t seed;
+    int generation;
 } Population;
 
-Population* ga_create_population(int size, int nn_inputs, int nn_hidden, int nn_outputs, float mutation_rate);
+Population* ga_create_population(int size, int nn_inputs, int nn_hidden, int nn_outputs, float mutation_rate,
+                                 float elite_fraction, GenomeFormat format, uint64_t seed);
 void ga_destroy_population(Population* pop);
-void ga_evolve(Population* pop);
+// Breeds the next generation from creature fitness. Children are bred in
+// parallel on `pool` when it is not NULL.
+void ga_evolve(Population* pop, ThreadPool* pool);
+// Genomes ga_evolve keeps unchanged out of `size`: the fittest `fraction`
+// of them, at least one
+int ga_elite_count(int size, float fraction);
+
+// Steady-state evolution, in place of ga_evolve: children are bred one
+// at a time, evaluated outside the arena and then compete for a place in
+// it. `birth` keys each child's random streams, so results do not depend
+// on which thread breeds it.
+
+typedef enum {
+    STEADY_BREED,  // Parents, crossover and mutation of the child
+    STEADY_REPLACE // The creatures it competes with
+} SteadyDraw;
+
+// Random stream of one kind of draw for the steady-state child `birth`.
+// The kinds are seeded apart, so no draw of one repeats the other's.
+void ga_steady_rng(const Population* pop, uint64_t birth, SteadyDraw draw, Rng* rng);
+
+// Ranks creature fitness and finds the elites ga_breed_child draws from
+void ga_rank_elites(Population* pop);
+// Crossover and mutation of two elites of the last ga_rank_elites call
+// into `child_genes`, gene_stride elements in pop->format
+void ga_breed_child(const Population* pop, uint64_t birth, void* child_genes);
+// Copies an evaluated child over the poorest of a few random creatures if
+// it is fitter. Returns the index replaced, or -1.
+int ga_replace_poor(Population* pop, const void* child_genes, float fitness, uint64_t birth);
+
+// Fills out[0, count rounded up to GA_NOISE_BLOCK) with noise of unit
+// scale: uniform in [-1, 1), or approximately normal with unit variance.
+// Each value depends only on (key, index), so any split of the work
+// gives the same noise.
+void ga_noise(MutationNoise kind, uint32_t key, float* out, int count);
+
+// Moves the k fittest of n ranks to the front of the array, in no
+// particular order
+void ga_select_top(CreatureRank* ranks, int n, int k);
+
+// Elements per genome in the arena, gene_count padded to GENOME_ALIGN_BYTES
+static inline int ga_gene_stride(int gene_count, GenomeFormat format) {
+    int align = GENOME_ALIGN_BYTES / genome_element_size(format);
+    return (gene_count + align - 1) / align * align;
+}
+
+// Genome of creature `index` in the current generation, in pop->format
+static inline void* ga_genome(const Population* pop, int index) {
+    return (unsigned char*)pop->genes + (size_t)index * pop->gene_stride * genome_element_size(pop->format);
+}
+
+// Genome `index` of the spare arena, which ga_evolve breeds into. Free
+// for children under evaluation when evolution is steady-state.
+static inline void* ga_spare_genome(const Population* pop, int index) {
+    return (unsigned char*)pop->next_genes + (size_t)index * pop->gene_stride * genome_element_size(pop->format);
+}
+
+// Widens the genome of creature `index` to gene_count floats
+void ga_decode_genome(const Population* pop, int index, float* out);
+// Gene diversity of the current generation: the standard deviation of
+// each gene across the population, averaged over genes
+float ga_diversity(const Population* pop);
 
 #endif // GENETICS_H
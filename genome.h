@@ -0,0 +1,98 @@
+#ifndef GENOME_H
+#define GENOME_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// Storage formats for network weights, in genomes and controller batches.
+// Compact formats shrink every genome copy in ga_evolve and every weight
+// load in inference; weights are widened to float only in registers.
+typedef enum {
+    GENOME_F32,
+    GENOME_F16, // IEEE half precision, round to nearest even
+    GENOME_I8   // Signed codes times GENOME_I8_SCALE
+} GenomeFormat;
+
+// int8 weights cover [-GENOME_I8_RANGE, GENOME_I8_RANGE] in 255 steps.
+// The scale is the same for every tensor of every genome, so crossover
+// copies codes unchanged; values outside the range saturate.
+#define GENOME_I8_RANGE 4.0f
+#define GENOME_I8_SCALE (GENOME_I8_RANGE / 127.0f)
+
+static inline int genome_element_size(GenomeFormat format) {
+    return format == GENOME_F16 ? 2 : format == GENOME_I8 ? 1 : 4;
+}
+
+static inline const char* genome_format_name(GenomeFormat format) {
+    return format == GENOME_F16 ? "f16" : format == GENOME_I8 ? "i8" : "f32";
+}
+
+static inline uint16_t genome_f16_encode(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = x & 0x80000000u;
+    x ^= sign;
+
+    uint32_t h;
+    if (x >= 0x477FF000u) {
+        // Rounds past the largest half, or NaN: saturate instead of inf
+        h = 0x7BFF;
+    } else if (x < 0x38800000u) {
+        // Below the smallest normal half: let float addition round it
+        // into a subnormal (magic 0.5f)
+        float v;
+        memcpy(&v, &x, sizeof(v));
+        v += 0.5f;
+        memcpy(&x, &v, sizeof(x));
+        h = x - 0x3F000000u;
+    } else {
+        // Rebias the exponent and round the mantissa to nearest even
+        uint32_t odd = (x >> 13) & 1;
+        x += 0xC8000FFFu + odd; // (15 - 127) << 23, plus the rounding bias
+        h = x >> 13;
+    }
+    return (uint16_t)(h | (sign >> 16));
+}
+
+static inline float genome_f16_decode(uint16_t h) {
+    // Exact for normals and subnormals: move the bits into place, then
+    // rescale the exponent by 2^(127 - 15)
+    uint32_t bits = (uint32_t)(h & 0x7FFF) << 13;
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    v *= 0x1p112f;
+    memcpy(&bits, &v, sizeof(bits));
+    bits |= (uint32_t)(h & 0x8000) << 16;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static inline int8_t genome_i8_encode(float f) {
+    // Branch free: the sign of mutated genes is unpredictable
+    float q = fminf(fmaxf(f * (127.0f / GENOME_I8_RANGE), -127.0f), 127.0f);
+    return (int8_t)(q + copysignf(0.5f, q));
+}
+
+static inline float genome_i8_decode(int8_t q) {
+    return q * GENOME_I8_SCALE;
+}
+
+// Element `i` of an array stored in `format`
+static inline float genome_get(GenomeFormat format, const void* genes, int i) {
+    switch (format) {
+    case GENOME_F16: return genome_f16_decode(((const uint16_t*)genes)[i]);
+    case GENOME_I8: return genome_i8_decode(((const int8_t*)genes)[i]);
+    default: return ((const float*)genes)[i];
+    }
+}
+
+static inline void genome_set(GenomeFormat format, void* genes, int i, float value) {
+    switch (format) {
+    case GENOME_F16: ((uint16_t*)genes)[i] = genome_f16_encode(value); break;
+    case GENOME_I8: ((int8_t*)genes)[i] = genome_i8_encode(value); break;
+    default: ((float*)genes)[i] = value; break;
+    }
+}
+
+#endif // GENOME_H
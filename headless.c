@@ -0,0 +1,642 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nn.h"
+#include "genetics.h"
+#include "simulation.h"
+#include "checkpoint.h"
+#include "island.h"
+#include "sweep.h"
+#include "profile.h"
+#include "timer.h"
+
+#define DEFAULT_GENERATIONS 100
+#define DEFAULT_DT (1.0f / 60.0f)
+#define DEFAULT_CHECKPOINT_EVERY 10
+#define DEFAULT_MIGRATE_EVERY 5
+#define DEFAULT_MIGRANTS 2
+#define DEFAULT_ARCHIVE_ADD 10
+#define SWEEP_LEADERS 5 // Configurations listed at the end of a sweep
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  -g, --generations N   Generations to train (default %d)\n", DEFAULT_GENERATIONS);
+    printf("  -s, --seed N          Random seed (default: time)\n");
+    printf("  -t, --dt SECONDS      Fixed physics timestep (default 1/60)\n");
+    printf("  -j, --threads N       Worker threads (default: all cores)\n");
+    printf("      --config PATH     Read the settings below from 'key = value' lines; flags override it\n");
+    printf("      --population N    Creatures per generation (default %d)\n", DEFAULT_POPULATION_SIZE);
+    printf("      --hidden N        Hidden neurons per controller (default %d)\n", DEFAULT_NN_HIDDEN);
+    printf("      --mutation-rate R Chance each gene mutates (default %.2f)\n", DEFAULT_MUTATION_RATE);
+    printf("      --mutation-noise N  ga mutation step: 'uniform' (default) or 'gaussian'\n");
+    printf("      --elite-fraction F  Share of the population kept unchanged by the ga (default %.2f)\n",
+           DEFAULT_ELITE_FRACTION);
+    printf("      --leg-force N     Force of the ankles at full controller output (default %.0f)\n", DEFAULT_LEG_FORCE);
+    printf("      --arm-force N     Force of the hands at full controller output (default %.0f)\n", DEFAULT_ARM_FORCE);
+    printf("      --duration S      Seconds simulated per generation (default %.0f)\n", DEFAULT_SIM_DURATION);
+    printf("      --chunk N         Simulate N creatures at a time (default: the whole population)\n");
+    printf("      --memory-budget MB  Pick a chunk size that fits in MB, or refuse to start\n");
+    printf("      --genome FORMAT   Store genomes as f32 (default), f16 or i8\n");
+    printf("      --scenarios K     Evaluate each genome in K scenarios at once (default 1)\n");
+    printf("      --combine MODE    Score over scenarios: 'mean' (default), 'min' or 'quantile'\n");
+    printf("      --quantile Q      quantile: which quantile of the scenario fitness (default %.2f)\n", DEFAULT_QUANTILE);
+    printf("      --terrain PX      Scenarios past the first: hills up to PX high (default 0: flat)\n");
+    printf("      --start-offset PX Scenarios past the first: shift the start by up to PX\n");
+    printf("      --push V          Scenarios past the first: one sideways push of up to V px/s\n");
+    printf("      --join MODE       Join workers once per 'step' or 'generation' (default)\n");
+    printf("      --evolution MODE  'generational' (default) or 'steady': refill each slot as soon as it finishes\n");
+    printf("      --optimizer NAME  'ga' (default), 'es' (OpenAI-ES) or 'cma' (sep-CMA-ES)\n");
+    printf("      --sigma S         es, cma: initial noise scale (default 0.05 for es, 0.3 for cma)\n");
+    printf("      --learning-rate R es: Adam step size (default 0.03)\n");
+    printf("      --target F        Report the simulated time until the best fitness reaches F\n");
+    printf("      --novelty K       Breed from novelty: mean distance to the K nearest behaviors (default 0: off)\n");
+    printf("      --novelty-weight W  Blend of the selection score, 0 pure novelty (default) to 1 pure fitness\n");
+    printf("      --archive-add N   Most novel behaviors archived per generation (default %d)\n", DEFAULT_ARCHIVE_ADD);
+    printf("      --islands N       Train N populations in separate processes that trade their best genomes\n");
+    printf("      --migrate-every K Generations between migrations (default %d)\n", DEFAULT_MIGRATE_EVERY);
+    printf("      --migrants M      Genomes each island sends per migration (default %d)\n", DEFAULT_MIGRANTS);
+    printf("      --topology T      Migration topology: 'ring' (default) or 'random'\n");
+    printf("      --no-pin          Let the islands run on any core\n");
+    printf("      --sweep SPEC      Train every configuration of a grid or random search side by side;\n");
+    printf("                        --log gets one column per configuration\n");
+    printf("      --no-cache        Re-simulate genomes whose fitness is already known\n");
+    printf("      --fall-tilt RAD   Stop creatures whose torso tilts past RAD\n");
+    printf("      --stall-window S  Stop creatures that move less than the stall distance in S seconds\n");
+    printf("      --stall-distance PX  Stall distance in pixels (default 5)\n");
+    printf("      --bound-speed V   Stop creatures that cannot reach the elites at V px/s\n");
+    printf("      --check-interval S  Seconds between early termination checks (default 0.25)\n");
+    printf("      --solver MODE     Constraint solver: 'fixed' (default) or 'xpbd'\n");
+    printf("      --solver-iterations N  Sweeps for fixed, at most for xpbd (default 5)\n");
+    printf("      --solver-tolerance PX  xpbd: stop once no bone is off by more (default 0.5)\n");
+    printf("      --compliance C    xpbd: bone compliance, 0 is rigid (default 0)\n");
+    printf("      --approx-sqrt     Expand bone lengths around the rest length instead of sqrt\n");
+    printf("  -c, --checkpoint PATH Save a resumable checkpoint every few generations\n");
+    printf("      --checkpoint-every N  Generations between checkpoints (default %d)\n", DEFAULT_CHECKPOINT_EVERY);
+    printf("  -r, --resume PATH     Continue from a checkpoint up to --generations in total\n");
+    printf("      --trace PATH      Write a Chrome trace of every phase (make PROFILE=1 builds)\n");
+    printf("      --profile-csv PATH  Write per-generation phase timings (make PROFILE=1 builds)\n");
+    printf("      --record PATH     Write the trajectories of the first creatures of every generation for replay\n");
+    printf("      --record-count N  Creatures recorded per generation (default 1: the previous generation's best)\n");
+    printf("  -l, --log PATH        Write per-generation fitness CSV\n");
+    printf("  -b, --best PATH       Write best genome as raw float32 weights\n");
+}
+
+static void print_memory(const SimConfig* config, const MemoryEstimate* memory) {
+    int chunk = config->chunk_size > 0 && config->chunk_size < config->population_size ? config->chunk_size
+                                                                                      : config->population_size;
+    printf("Memory: %zu bytes per creature + %zu per simulated creature, %.1f MB for %d creatures",
+           memory->per_creature, memory->per_slot, memory->total / (1024.0 * 1024.0), config->population_size);
+    if (chunk < config->population_size) printf(" in chunks of %d", chunk);
+    if (config->genome_format != GENOME_F32) printf(", %s genomes", genome_format_name(config->genome_format));
+    if (memory->cache > 0) printf(" (%.1f MB fitness cache)", memory->cache / (1024.0 * 1024.0));
+    printf("\n");
+}
+
+static int write_genes(const float* genes, int gene_count, const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) {
+        printf("Could not open %s for writing\n", path);
+        return 0;
+    }
+    fwrite(genes, sizeof(float), gene_count, f);
+    fclose(f);
+    return 1;
+}
+
+static int write_best_genome(Population* pop, const char* path) {
+    float* genes = (float*)malloc(pop->gene_count * sizeof(float));
+    ga_decode_genome(pop, pop->best_index, genes);
+    int ok = write_genes(genes, pop->gene_count, path);
+    free(genes);
+    return ok;
+}
+
+// Settings applied to every simulation, the islands' included
+typedef struct {
+    int use_cache;
+    EarlyTermination early;
+    SolverSettings solver;
+    EvolutionMode evolution;
+    OptimizerSettings optimizer;
+    NoveltySettings novelty;
+} TrainingSettings;
+
+static void configure_simulation(SimulationState* sim, void* ctx) {
+    const TrainingSettings* training = (const TrainingSettings*)ctx;
+    if (training->use_cache) simulation_enable_fitness_cache(sim);
+    simulation_set_early_termination(sim, &training->early);
+    simulation_set_solver(sim, &training->solver);
+    simulation_set_evolution(sim, training->evolution);
+    if (training->optimizer.kind != OPTIMIZER_GA) simulation_set_optimizer(sim, &training->optimizer);
+    if (training->novelty.neighbours > 0) simulation_set_novelty(sim, &training->novelty);
+}
+
+static int run_islands(const IslandSettings* settings, const SimConfig* config, TrainingSettings* training,
+                       uint64_t seed, int threads, float dt, int generations, const char* log_path,
+                       const char* best_path) {
+    int n = settings->island_count;
+    int island_threads = threads / n > 0 ? threads / n : 1;
+    printf("Island training: %d islands of %d creatures, %d threads each, %d generations, seed %llu, dt %.5f\n",
+           n, config->population_size, island_threads, generations, (unsigned long long)seed, dt);
+    printf("  %d migrants every %d generations, %s topology\n", settings->migrants, settings->migrate_every,
+           settings->topology == ISLAND_RING ? "ring" : "random");
+
+    double start = timer_now();
+    IslandShared* shared = island_run(settings, config, seed, island_threads, dt, generations,
+                                      configure_simulation, training);
+    if (shared == NULL) return 1;
+    double elapsed = timer_now() - start;
+    if (elapsed <= 0) elapsed = 1e-9;
+
+    long long creature_steps = 0;
+    double migration_seconds = 0, island_seconds = 0;
+    int best_island = 0;
+    for (int i = 0; i < n; i++) {
+        const IslandStats* stats = &shared->stats[i];
+        double seconds = stats->seconds > 0 ? stats->seconds : 1e-9;
+        printf("  island %d: %.2f generations/sec, best %.2f, diversity %.4f, %d migrations in %.3f s"
+               " (%.3f s waiting, %.1f%% of its time)\n",
+               i, stats->generations / seconds, stats->best_fitness,
+               island_record(shared, i, generations)->diversity, stats->migrations, stats->migration_seconds,
+               stats->wait_seconds, 100.0 * stats->migration_seconds / seconds);
+        creature_steps += stats->creature_steps;
+        migration_seconds += stats->migration_seconds;
+        island_seconds += stats->seconds;
+        if (stats->best_fitness > shared->stats[best_island].best_fitness) best_island = i;
+    }
+    printf("Trained %d generations on %d islands in %.3f s\n", generations, n, elapsed);
+    printf("  %.0f biped steps/sec across islands\n", creature_steps / elapsed);
+    printf("  %.1f%% of island time spent migrating\n",
+           island_seconds > 0 ? 100.0 * migration_seconds / island_seconds : 0.0);
+
+    int ok = 1;
+    if (log_path != NULL) {
+        FILE* log_file = fopen(log_path, "w");
+        if (log_file == NULL) {
+            printf("Could not open %s for writing\n", log_path);
+            ok = 0;
+        } else {
+            fprintf(log_file, "island,generation,best,avg,worst,diversity\n");
+            for (int i = 0; i < n; i++) {
+                for (int g = 1; g <= generations; g++) {
+                    const IslandRecord* record = island_record(shared, i, g);
+                    fprintf(log_file, "%d,%d,%f,%f,%f,%f\n", i, g, record->best, record->avg, record->worst,
+                            record->diversity);
+                }
+            }
+            fclose(log_file);
+        }
+    }
+    if (best_path != NULL) {
+        const float* genes = shared->best_genomes + (size_t)best_island * shared->gene_count;
+        ok = write_genes(genes, shared->gene_count, best_path) && ok;
+    }
+    island_release(shared);
+    return ok ? 0 : 1;
+}
+
+static int run_sweep(const SweepSpec* spec, const SimConfig* config, TrainingSettings* training, uint64_t seed,
+                     int threads, float dt, int generations, const char* log_path) {
+    int count;
+    SweepExperiment* experiments = sweep_plan(spec, config, seed, &count);
+    if (experiments == NULL) return 1;
+
+    // Every configuration is held in memory from its first generation
+    // until it stops
+    double total = 0;
+    for (int i = 0; i < count; i++) {
+        MemoryEstimate memory;
+        if (!simulation_fit_memory_budget(&experiments[i].config, training->use_cache, &memory)) {
+            printf("Configuration %d does not fit the %.0f MB memory budget\n", i, config->memory_budget_mb);
+            sweep_release(experiments, count);
+            return 1;
+        }
+        total += memory.total;
+    }
+    if (config->memory_budget_mb > 0 && total > config->memory_budget_mb * 1024 * 1024) {
+        printf("The %d configurations need %.1f MB at once, over the %.0f MB memory budget\n", count,
+               total / (1024.0 * 1024.0), config->memory_budget_mb);
+        sweep_release(experiments, count);
+        return 1;
+    }
+    printf("Sweep: %d configurations from a %s search, %d generations each, seed %llu, dt %.5f, %d threads\n",
+           count, spec->search == SWEEP_GRID ? "grid" : "random", generations, (unsigned long long)seed, dt,
+           threads);
+    if (spec->rung > 0) {
+        printf("  successive halving from generation %d, keeping 1/%d at each rung\n", spec->rung, spec->eta);
+    }
+    printf("  %.1f MB for all configurations at once\n", total / (1024.0 * 1024.0));
+
+    SweepStats stats;
+    sweep_run(spec, experiments, count, seed, threads, dt, generations, configure_simulation, training, &stats);
+    double elapsed = stats.seconds > 0 ? stats.seconds : 1e-9;
+    long long budget = (long long)count * generations;
+    printf("Trained %d generations of %d configurations in %.3f s\n", stats.generations, count, elapsed);
+    printf("  %.2f generations/sec, %.0f biped steps/sec\n", stats.generations / elapsed,
+           stats.creature_steps / elapsed);
+    if (stats.rungs > 0) {
+        printf("  %d rungs of successive halving skipped %.1f%% of the %lld generations of a full sweep\n",
+               stats.rungs, 100.0 * (budget - stats.generations) / budget, budget);
+    }
+
+    // The configurations that trained longest, fittest first
+    int shown[SWEEP_LEADERS];
+    int leaders = 0;
+    while (leaders < SWEEP_LEADERS && leaders < count) {
+        int best = -1;
+        for (int i = 0; i < count; i++) {
+            int taken = 0;
+            for (int k = 0; k < leaders; k++) taken = taken || shown[k] == i;
+            if (taken || experiments[i].generations == 0) continue;
+            const SweepExperiment* e = &experiments[i];
+            const SweepExperiment* b = best >= 0 ? &experiments[best] : NULL;
+            if (b == NULL || e->generations > b->generations ||
+                (e->generations == b->generations &&
+                 e->best[e->generations - 1] > b->best[b->generations - 1])) {
+                best = i;
+            }
+        }
+        if (best < 0) break;
+        shown[leaders++] = best;
+        const SweepExperiment* e = &experiments[best];
+        printf("  #%d: configuration %d, best %.2f after %d generations:", leaders, best,
+               e->best[e->generations - 1], e->generations);
+        for (int p = 0; p < spec->param_count; p++) printf(" %s=%s", spec->params[p].key, e->values[p]);
+        printf("\n");
+    }
+
+    int ok = 1;
+    if (log_path != NULL) ok = sweep_write_results(log_path, spec, experiments, count, generations);
+    sweep_release(experiments, count);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    int generations = DEFAULT_GENERATIONS;
+    uint64_t seed = (uint64_t)time(NULL);
+    float dt = DEFAULT_DT;
+    int threads = pool_cpu_count();
+    int join_per_step = 0;
+    TrainingSettings training = {1, {0, 0, 5.0f, 0, 0.25f}, {SOLVER_FIXED, 0, 0.5f, 0, 0},
+                                 EVOLUTION_GENERATIONAL, {OPTIMIZER_GA, 0, 0}, {0, 0, DEFAULT_ARCHIVE_ADD}};
+    EarlyTermination* early = &training.early;
+    SolverSettings* solver = &training.solver;
+    OptimizerSettings* optimizer = &training.optimizer;
+    NoveltySettings* novelty = &training.novelty;
+    IslandSettings islands = {1, DEFAULT_MIGRATE_EVERY, DEFAULT_MIGRANTS, ISLAND_RING, 1};
+    float target = 0;
+    int has_target = 0;
+    const char* checkpoint_path = NULL;
+    int checkpoint_every = DEFAULT_CHECKPOINT_EVERY;
+    const char* resume_path = NULL;
+    const char* log_path = NULL;
+    const char* trace_path = NULL;
+    const char* profile_csv_path = NULL;
+    const char* best_path = NULL;
+    const char* record_path = NULL;
+    int record_count = 1;
+    const char* sweep_path = NULL;
+
+    // The config file first, so flags override it wherever they appear
+    SimConfig config;
+    config_defaults(&config);
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--config") == 0 && !config_load(&config, argv[i + 1])) return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (strcmp(arg, "--no-cache") == 0) {
+            training.use_cache = 0;
+            continue;
+        }
+        if (strcmp(arg, "--no-pin") == 0) {
+            islands.pin = 0;
+            continue;
+        }
+        if (strcmp(arg, "--approx-sqrt") == 0) {
+            solver->approx_sqrt = 1;
+            continue;
+        }
+        if (value == NULL) {
+            printf("Missing value for %s\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "-g") == 0 || strcmp(arg, "--generations") == 0) {
+            generations = atoi(value);
+        } else if (strcmp(arg, "-s") == 0 || strcmp(arg, "--seed") == 0) {
+            seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "-t") == 0 || strcmp(arg, "--dt") == 0) {
+            dt = (float)atof(value);
+        } else if (strcmp(arg, "-j") == 0 || strcmp(arg, "--threads") == 0) {
+            threads = atoi(value);
+        } else if (strcmp(arg, "--join") == 0) {
+            if (strcmp(value, "step") == 0) {
+                join_per_step = 1;
+            } else if (strcmp(value, "generation") == 0) {
+                join_per_step = 0;
+            } else {
+                printf("Unknown join mode %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--evolution") == 0) {
+            if (strcmp(value, "generational") == 0) {
+                training.evolution = EVOLUTION_GENERATIONAL;
+            } else if (strcmp(value, "steady") == 0) {
+                training.evolution = EVOLUTION_STEADY;
+            } else {
+                printf("Unknown evolution mode %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--optimizer") == 0) {
+            if (!optimizer_parse(value, &optimizer->kind)) {
+                printf("Unknown optimizer %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--sigma") == 0) {
+            optimizer->sigma = (float)atof(value);
+        } else if (strcmp(arg, "--learning-rate") == 0) {
+            optimizer->learning_rate = (float)atof(value);
+        } else if (strcmp(arg, "--novelty") == 0) {
+            novelty->neighbours = atoi(value);
+        } else if (strcmp(arg, "--novelty-weight") == 0) {
+            novelty->weight = (float)atof(value);
+        } else if (strcmp(arg, "--archive-add") == 0) {
+            novelty->archive_add = atoi(value);
+        } else if (strcmp(arg, "--islands") == 0) {
+            islands.island_count = atoi(value);
+        } else if (strcmp(arg, "--migrate-every") == 0) {
+            islands.migrate_every = atoi(value);
+        } else if (strcmp(arg, "--migrants") == 0) {
+            islands.migrants = atoi(value);
+        } else if (strcmp(arg, "--topology") == 0) {
+            if (strcmp(value, "ring") == 0) {
+                islands.topology = ISLAND_RING;
+            } else if (strcmp(value, "random") == 0) {
+                islands.topology = ISLAND_RANDOM;
+            } else {
+                printf("Unknown topology %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--sweep") == 0) {
+            sweep_path = value;
+        } else if (strcmp(arg, "--target") == 0) {
+            target = (float)atof(value);
+            has_target = 1;
+        } else if (strcmp(arg, "--fall-tilt") == 0) {
+            early->max_torso_tilt = (float)atof(value);
+        } else if (strcmp(arg, "--stall-window") == 0) {
+            early->stall_window = (float)atof(value);
+        } else if (strcmp(arg, "--stall-distance") == 0) {
+            early->stall_distance = (float)atof(value);
+        } else if (strcmp(arg, "--bound-speed") == 0) {
+            early->max_speed = (float)atof(value);
+        } else if (strcmp(arg, "--check-interval") == 0) {
+            early->check_interval = (float)atof(value);
+        } else if (strcmp(arg, "--solver") == 0) {
+            if (strcmp(value, "fixed") == 0) {
+                solver->mode = SOLVER_FIXED;
+            } else if (strcmp(value, "xpbd") == 0) {
+                solver->mode = SOLVER_XPBD;
+            } else {
+                printf("Unknown solver %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--solver-iterations") == 0) {
+            solver->iterations = atoi(value);
+        } else if (strcmp(arg, "--solver-tolerance") == 0) {
+            solver->tolerance = (float)atof(value);
+        } else if (strcmp(arg, "--compliance") == 0) {
+            solver->compliance = (float)atof(value);
+        } else if (strcmp(arg, "--config") == 0) {
+            // Read above
+        } else if (strncmp(arg, "--", 2) == 0 && config_has_key(arg + 2)) {
+            if (!config_set(&config, arg + 2, value)) return 1;
+        } else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--checkpoint") == 0) {
+            checkpoint_path = value;
+        } else if (strcmp(arg, "--checkpoint-every") == 0) {
+            checkpoint_every = atoi(value);
+        } else if (strcmp(arg, "-r") == 0 || strcmp(arg, "--resume") == 0) {
+            resume_path = value;
+        } else if (strcmp(arg, "--trace") == 0) {
+            trace_path = value;
+        } else if (strcmp(arg, "--profile-csv") == 0) {
+            profile_csv_path = value;
+        } else if (strcmp(arg, "--record") == 0) {
+            record_path = value;
+        } else if (strcmp(arg, "--record-count") == 0) {
+            record_count = atoi(value);
+        } else if (strcmp(arg, "-l") == 0 || strcmp(arg, "--log") == 0) {
+            log_path = value;
+        } else if (strcmp(arg, "-b") == 0 || strcmp(arg, "--best") == 0) {
+            best_path = value;
+        } else {
+            printf("Unknown option %s\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    if (generations <= 0 || dt <= 0 || threads <= 0 || checkpoint_every <= 0) {
+        printf("Generations, dt, threads and checkpoint interval must be positive\n");
+        return 1;
+    }
+    if (record_path != NULL && (record_count <= 0 || training.evolution == EVOLUTION_STEADY)) {
+        printf("Recording needs a positive --record-count and generational evolution\n");
+        return 1;
+    }
+    if (training.evolution == EVOLUTION_STEADY && (optimizer->kind != OPTIMIZER_GA || config.scenario_count > 1)) {
+        printf("Steady-state evolution needs the ga optimizer and a single scenario\n");
+        return 1;
+    }
+    if (novelty->neighbours != 0) {
+        if (novelty->neighbours < 0 || novelty->neighbours > NOVELTY_MAX_NEIGHBOURS || novelty->weight < 0 ||
+            novelty->weight > 1 || novelty->archive_add < 1) {
+            printf("Novelty needs 1-%d neighbours, a weight in [0, 1] and a positive --archive-add\n",
+                   NOVELTY_MAX_NEIGHBOURS);
+            return 1;
+        }
+        if (training.evolution != EVOLUTION_GENERATIONAL || optimizer->kind != OPTIMIZER_GA) {
+            printf("Novelty search needs generational evolution with the ga optimizer\n");
+            return 1;
+        }
+        // The archive is not part of a checkpoint, so a resumed run could not
+        // score novelty as the uninterrupted one would
+        if (checkpoint_path != NULL || resume_path != NULL) {
+            printf("Novelty search does not support --checkpoint or --resume\n");
+            return 1;
+        }
+    }
+
+#ifdef WALK_PROFILE
+    if (!profile_open(trace_path, profile_csv_path)) return 1;
+#else
+    if (trace_path != NULL || profile_csv_path != NULL) {
+        printf("Built without profiling; rebuild with make PROFILE=1 for --trace and --profile-csv\n");
+        return 1;
+    }
+#endif
+
+    if (resume_path != NULL && !checkpoint_read_config(resume_path, &config)) return 1;
+    MemoryEstimate memory;
+    if (!simulation_fit_memory_budget(&config, training.use_cache, &memory)) {
+        print_memory(&config, &memory);
+        printf("Does not fit the %.0f MB memory budget\n", config.memory_budget_mb);
+        return 1;
+    }
+    print_memory(&config, &memory);
+
+    if (sweep_path != NULL) {
+        if (islands.island_count > 1 || resume_path != NULL || checkpoint_path != NULL || trace_path != NULL ||
+            profile_csv_path != NULL || record_path != NULL || best_path != NULL) {
+            printf("Sweeps do not support --islands, --checkpoint, --resume, --trace, --profile-csv, --record or"
+                   " --best\n");
+            return 1;
+        }
+        SweepSpec spec;
+        if (!sweep_load(&spec, sweep_path)) return 1;
+        return run_sweep(&spec, &config, &training, seed, threads, dt, generations, log_path);
+    }
+
+    if (islands.island_count > 1) {
+        if (resume_path != NULL || checkpoint_path != NULL || trace_path != NULL || profile_csv_path != NULL ||
+            record_path != NULL) {
+            printf("Islands do not support --checkpoint, --resume, --trace, --profile-csv or --record\n");
+            return 1;
+        }
+        if (training.evolution != EVOLUTION_GENERATIONAL || optimizer->kind != OPTIMIZER_GA) {
+            printf("Islands need generational evolution with the ga optimizer\n");
+            return 1;
+        }
+        if (islands.migrate_every <= 0 || islands.migrants <= 0 ||
+            islands.migrants > config.population_size - ga_elite_count(config.population_size, config.elite_fraction)) {
+            printf("Migration interval and migrants must be positive, and migrants must not displace the elites\n");
+            return 1;
+        }
+        return run_islands(&islands, &config, &training, seed, threads, dt, generations, log_path, best_path);
+    }
+
+    SimulationState* sim;
+    if (resume_path != NULL) {
+        sim = checkpoint_resume(resume_path, &config, threads);
+        if (sim == NULL) return 1;
+        seed = sim->population->seed;
+        printf("Resumed %s at generation %d\n", resume_path, sim->generation);
+    } else {
+        sim = simulation_create(&config, seed, threads);
+    }
+    configure_simulation(sim, &training);
+    if (record_path != NULL && !simulation_record_trajectories(sim, record_path, record_count, dt)) {
+        simulation_destroy(sim);
+        return 1;
+    }
+
+    FILE* log_file = NULL;
+    if (log_path != NULL) {
+        log_file = fopen(log_path, "w");
+        if (log_file == NULL) {
+            printf("Could not open %s for writing\n", log_path);
+            simulation_destroy(sim);
+            return 1;
+        }
+        fprintf(log_file, sim->archive != NULL ? "generation,best,avg,worst,novelty\n" : "generation,best,avg,worst\n");
+    }
+
+    int first_generation = sim->generation;
+    printf("Headless training: generations %d-%d, seed %llu, dt %.5f, %d threads\n",
+           first_generation, generations, (unsigned long long)seed, dt, threads);
+
+    long long steps = 0;
+    int ok = 1;
+    int target_generation = 0;
+    double target_sim_seconds = 0, target_wall_seconds = 0;
+
+    double start = timer_now();
+    while (sim->generation <= generations) {
+        int generation = sim->generation;
+        if (join_per_step) {
+            simulation_update(sim, dt);
+            steps++;
+        } else {
+            steps += simulation_run_generation(sim, dt);
+        }
+        if (sim->generation == generation) continue;
+
+        if (has_target && target_generation == 0 && sim->best_fitness >= target) {
+            target_generation = generation;
+            target_sim_seconds = sim->creature_steps * (double)dt;
+            target_wall_seconds = timer_now() - start;
+        }
+
+        if (log_file != NULL) {
+            fprintf(log_file, "%d,%f,%f,%f", generation, sim->best_fitness, sim->avg_fitness, sim->worst_fitness);
+            if (sim->archive != NULL) fprintf(log_file, ",%f", sim->avg_novelty);
+            fprintf(log_file, "\n");
+        }
+        if (checkpoint_path != NULL && (generation % checkpoint_every == 0 || generation == generations)) {
+            ok = checkpoint_save(sim, checkpoint_path) && ok;
+        }
+    }
+    double elapsed = timer_now() - start;
+    if (elapsed <= 0) elapsed = 1e-9;
+
+    int trained = sim->generation - first_generation;
+    printf("Trained %d generations in %.3f s\n", trained, elapsed);
+    printf("  %.2f generations/sec\n", trained / elapsed);
+    printf("  %.0f physics steps/sec (%.0f biped steps/sec)\n",
+           steps / elapsed, sim->creature_steps / elapsed);
+    if (sim->solver_block_steps > 0) {
+        printf("  %.2f constraint sweeps per step on average\n",
+               (double)sim->solver_sweeps / sim->solver_block_steps);
+    }
+
+    if (has_target) {
+        if (target_generation > 0) {
+            printf("  %s reached fitness %.2f in generation %d after %.0f simulated creature-seconds (%.3f s)\n",
+                   optimizer_name(optimizer->kind), target, target_generation, target_sim_seconds,
+                   target_wall_seconds);
+        } else {
+            printf("  %s did not reach fitness %.2f in %.0f simulated creature-seconds\n",
+                   optimizer_name(optimizer->kind), target, sim->creature_steps * (double)dt);
+        }
+    }
+
+    if (sim->fitness_cache != NULL) {
+        FitnessCache* cache = sim->fitness_cache;
+        long long lookups = cache->hits + cache->misses;
+        printf("  fitness cache: %lld hits, %lld misses (%.1f%% of evaluations skipped)\n",
+               cache->hits, cache->misses, lookups > 0 ? 100.0 * cache->hits / lookups : 0.0);
+    }
+
+    if (sim->archive != NULL) {
+        printf("  novelty archive: %d behaviors in %d k-d trees, %.2f ms per generation scoring and archiving\n",
+               sim->archive->count, sim->archive->tree_count, trained > 0 ? 1000.0 * sim->novelty_seconds / trained : 0.0);
+    }
+
+    if (sim->recorder != NULL) {
+        TrajectoryRecorder* rec = sim->recorder;
+        long long raw = rec->steps * rec->coordinates * (long long)sizeof(float);
+        printf("  recorded %lld trajectories, %lld steps in %.1f KB (%.1f bytes per step, %.1fx smaller than float32),"
+               " %.3f s encoding and writing (%.1f%% of the run)\n",
+               rec->records, rec->steps, rec->bytes / 1024.0, rec->steps > 0 ? (double)rec->bytes / rec->steps : 0.0,
+               rec->bytes > 0 ? (double)raw / rec->bytes : 0.0, rec->seconds, 100.0 * rec->seconds / elapsed);
+        ok = simulation_stop_recording(sim) && ok;
+    }
+    if (log_file != NULL) fclose(log_file);
+    if (best_path != NULL) ok = write_best_genome(sim->population, best_path) && ok;
+
+    simulation_destroy(sim);
+#ifdef WALK_PROFILE
+    profile_close();
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+#define _GNU_SOURCE // sched_setaffinity
+#include "island.h"
+#include "timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#define ISLAND_SEED_SALT 0x94D049BB133111EBULL // Keeps the topology's stream apart from the islands'
+#define ISLAND_POLL_NS 50000 // Sleep between looks at another island's mailbox
+
+#ifndef _WIN32
+
+static size_t align_up(size_t n, size_t alignment) {
+    return (n + alignment - 1) / alignment * alignment;
+}
+
+static unsigned char* slot_genome(const IslandShared* shared, int island, int slot, int k) {
+    return shared->slots + (((size_t)island * 2 + slot) * shared->settings.migrants + k) * shared->genome_size;
+}
+
+// Island that `island` takes migrants from in migration `migration`
+static int island_source(const IslandShared* shared, uint64_t seed, int island, int migration) {
+    int n = shared->settings.island_count;
+    if (shared->settings.topology == ISLAND_RING) return (island + n - 1) % n;
+
+    // Every island draws the same shuffle, so they agree on the ring
+    int order[n];
+    for (int i = 0; i < n; i++) order[i] = i;
+    Rng rng;
+    rng_seed(&rng, seed ^ ISLAND_SEED_SALT, (uint64_t)migration);
+    for (int i = n - 1; i > 0; i--) {
+        int j = rng_int(&rng, i + 1);
+        int swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+    int k = 0;
+    while (order[k] != island) k++;
+    return order[(k + n - 1) % n];
+}
+
+// Sleeps until `counter` reaches `value`. Returns the seconds waited.
+static double wait_for(atomic_int* counter, int value) {
+    double start = timer_now();
+    while (atomic_load_explicit(counter, memory_order_acquire) < value) {
+        struct timespec pause = {0, ISLAND_POLL_NS};
+        nanosleep(&pause, NULL);
+    }
+    return timer_now() - start;
+}
+
+// Sends the island's best genomes and takes in those of its source. Runs
+// right after ga_evolve, so the elites lead the arena and the children
+// behind them have not been simulated yet.
+static void migrate(IslandShared* shared, SimulationState* sim, uint64_t seed, int island, int migration) {
+    IslandStats* stats = &shared->stats[island];
+    Population* pop = sim->population;
+    int migrants = shared->settings.migrants;
+    int slot = migration % 2;
+    double start = timer_now();
+
+    // The slot was last written two migrations ago; wait until that was read
+    IslandMailbox* own = &shared->mailboxes[island];
+    stats->wait_seconds += wait_for(&own->consumed, migration - 1);
+
+    // Elite k sits at arena index k with the fitness of pop->ranks[k], but
+    // past rank 0 in no particular order, so pick the fittest of them
+    int elite_count = ga_elite_count(pop->population_size, pop->elite_fraction);
+    int picked = migrants < elite_count ? migrants : elite_count;
+    CreatureRank* top = (CreatureRank*)malloc(elite_count * sizeof(CreatureRank));
+    for (int k = 0; k < elite_count; k++) top[k] = (CreatureRank){pop->ranks[k].fitness, k};
+    ga_select_top(top, elite_count, picked);
+    for (int k = 0; k < migrants; k++) {
+        // More migrants than elites: the first children bred make up the rest
+        int index = k < picked ? top[k].index : k;
+        memcpy(slot_genome(shared, island, slot, k), ga_genome(pop, index), shared->genome_size);
+    }
+    free(top);
+    atomic_store_explicit(&own->published, migration + 1, memory_order_release);
+
+    // Migrants replace the last children bred, never the elites
+    int source = island_source(shared, seed, island, migration);
+    IslandMailbox* from = &shared->mailboxes[source];
+    stats->wait_seconds += wait_for(&from->published, migration + 1);
+    for (int k = 0; k < migrants; k++) {
+        memcpy(ga_genome(pop, pop->population_size - 1 - k), slot_genome(shared, source, slot, k),
+               shared->genome_size);
+    }
+    atomic_fetch_add_explicit(&from->consumed, 1, memory_order_release);
+    simulation_reload(sim);
+
+    stats->migration_seconds += timer_now() - start;
+    stats->migrations++;
+}
+
+// Restricts this process, and the pool threads it starts later, to its
+// share of the cores, so its memory stays on the node it runs on
+static void pin_island(int island, int island_count) {
+#ifdef __linux__
+    int cpus = pool_cpu_count();
+    int first = (int)((long long)island * cpus / island_count);
+    int last = (int)((long long)(island + 1) * cpus / island_count);
+    if (last == first) last = first + 1;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = first; cpu < last; cpu++) CPU_SET(cpu % cpus, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#endif
+}
+
+static int island_main(IslandShared* shared, int island, const SimConfig* config, uint64_t seed, int threads,
+                       float dt, IslandSetupFn setup, void* ctx) {
+    const IslandSettings* settings = &shared->settings;
+    IslandStats* stats = &shared->stats[island];
+    if (settings->pin) pin_island(island, settings->island_count);
+
+    Rng rng;
+    rng_seed(&rng, seed, (uint64_t)island);
+    uint64_t island_seed = ((uint64_t)rng_next(&rng) << 32) | rng_next(&rng);
+    SimulationState* sim = simulation_create(config, island_seed, threads);
+    sim->verbose = 0;
+    if (setup != NULL) setup(sim, ctx);
+
+    double start = timer_now();
+    while (sim->generation <= shared->generations) {
+        int generation = sim->generation;
+        simulation_run_generation(sim, dt);
+
+        if (generation % settings->migrate_every == 0 && generation < shared->generations) {
+            migrate(shared, sim, seed, island, generation / settings->migrate_every - 1);
+        }
+        IslandRecord* record = &shared->records[(size_t)island * shared->generations + generation - 1];
+        record->best = sim->best_fitness;
+        record->avg = sim->avg_fitness;
+        record->worst = sim->worst_fitness;
+        record->diversity = ga_diversity(sim->population);
+        stats->generations = generation;
+    }
+    stats->seconds = timer_now() - start;
+    stats->creature_steps = sim->creature_steps;
+    stats->best_fitness = sim->best_fitness;
+    ga_decode_genome(sim->population, sim->population->best_index,
+                     shared->best_genomes + (size_t)island * shared->gene_count);
+    simulation_destroy(sim);
+    return 0;
+}
+
+IslandShared* island_run(const IslandSettings* settings, const SimConfig* config, uint64_t seed, int threads,
+                         float dt, int generations, IslandSetupFn setup, void* ctx) {
+    int n = settings->island_count;
+    int gene_count = simulation_gene_count(config);
+    size_t genome_size = (size_t)gene_count * genome_element_size(config->genome_format);
+
+    // Header, mailboxes, stats, records, migrant slots, best genomes
+    size_t offsets[5];
+    size_t size = align_up(sizeof(IslandShared), 64);
+    offsets[0] = size;
+    size += (size_t)n * sizeof(IslandMailbox);
+    offsets[1] = size = align_up(size, 64);
+    size += (size_t)n * sizeof(IslandStats);
+    offsets[2] = size = align_up(size, 64);
+    size += (size_t)n * generations * sizeof(IslandRecord);
+    offsets[3] = size = align_up(size, 64);
+    size += (size_t)n * 2 * settings->migrants * genome_size;
+    offsets[4] = size = align_up(size, 64);
+    size += (size_t)n * gene_count * sizeof(float);
+
+    unsigned char* base = (unsigned char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        printf("Could not map %zu bytes shared by the islands\n", size);
+        return NULL;
+    }
+    IslandShared* shared = (IslandShared*)base;
+    shared->settings = *settings;
+    shared->generations = generations;
+    shared->gene_count = gene_count;
+    shared->genome_size = genome_size;
+    shared->mailboxes = (IslandMailbox*)(base + offsets[0]);
+    shared->stats = (IslandStats*)(base + offsets[1]);
+    shared->records = (IslandRecord*)(base + offsets[2]);
+    shared->slots = base + offsets[3];
+    shared->best_genomes = (float*)(base + offsets[4]);
+    shared->mapping_size = size;
+    for (int i = 0; i < n; i++) {
+        atomic_init(&shared->mailboxes[i].published, 0);
+        atomic_init(&shared->mailboxes[i].consumed, 0);
+    }
+
+    // Children inherit unflushed output
+    fflush(stdout);
+    pid_t* pids = (pid_t*)malloc(n * sizeof(pid_t));
+    int started = 0;
+    for (; started < n; started++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            int code = island_main(shared, started, config, seed, threads, dt, setup, ctx);
+            fflush(stdout);
+            _exit(code);
+        }
+        if (pid < 0) {
+            printf("Could not start island %d\n", started);
+            break;
+        }
+        pids[started] = pid;
+    }
+    if (started < n) {
+        for (int i = 0; i < started; i++) kill(pids[i], SIGTERM);
+    }
+
+    // A failed island would leave the others waiting for its migrants
+    int failed = started < n;
+    for (int remaining = started; remaining > 0; remaining--) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) break;
+        int island = 0;
+        while (pids[island] != pid) island++;
+        int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        shared->stats[island].exit_code = code;
+        if (code != 0 && !failed) {
+            printf("Island %d failed (exit code %d)\n", island, code);
+            failed = 1;
+            for (int i = 0; i < started; i++) {
+                if (i != island) kill(pids[i], SIGTERM);
+            }
+        }
+    }
+    free(pids);
+    if (failed) {
+        island_release(shared);
+        return NULL;
+    }
+    return shared;
+}
+
+void island_release(IslandShared* shared) {
+    munmap(shared, shared->mapping_size);
+}
+
+#else
+
+IslandShared* island_run(const IslandSettings* settings, const SimConfig* config, uint64_t seed, int threads,
+                         float dt, int generations, IslandSetupFn setup, void* ctx) {
+    printf("Islands run as forked processes, which this platform does not support\n");
+    return NULL;
+}
+
+void island_release(IslandShared* shared) {
+}
+
+#endif
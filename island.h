@@ -0,0 +1,85 @@
+#ifndef ISLAND_H
+#define ISLAND_H
+
+#include "simulation.h"
+#include <stdatomic.h>
+
+typedef enum {
+    ISLAND_RING,  // Island i sends to island i + 1
+    ISLAND_RANDOM // A ring through a new random order of the islands at every migration
+} IslandTopology;
+
+typedef struct {
+    int island_count;
+    int migrate_every; // Generations between migrations
+    int migrants;      // Genomes each island sends per migration
+    IslandTopology topology;
+    int pin; // Give each island its own share of the cores (Linux)
+} IslandSettings;
+
+typedef struct {
+    double seconds;           // Wall time of the island's training loop
+    double migration_seconds; // Publishing, waiting for and taking in migrants...
+    double wait_seconds;      // ...of which waiting for the source island
+    int migrations;
+    int generations;
+    long long creature_steps;
+    float best_fitness; // Of the last generation
+    int exit_code;
+} IslandStats;
+
+// Fitness of one island's generation, and the gene diversity of the
+// population bred from it, migrants included
+typedef struct {
+    float best;
+    float avg;
+    float worst;
+    float diversity;
+} IslandRecord;
+
+// One mailbox per island. A migration writes the island's best genomes
+// into slot (migration % 2) and bumps `published`; the island it sends to
+// copies them and bumps `consumed`. Slots are reused only once read, so
+// islands run at most one migration apart.
+typedef struct {
+    atomic_int published; // Migrations written
+    atomic_int consumed;  // Migrations read by their destination
+    char pad[56];
+} IslandMailbox;
+
+// Everything the islands share, in one anonymous shared mapping made
+// before they are forked. Each block is an array over islands.
+typedef struct {
+    IslandSettings settings;
+    int generations;
+    int gene_count;
+    size_t genome_size; // Bytes of one migrant genome in the population's format
+    IslandMailbox* mailboxes;
+    IslandStats* stats;
+    IslandRecord* records;    // [island][generation - 1]
+    unsigned char* slots;     // [island][2][migrants] genomes
+    float* best_genomes;      // [island][gene_count], widened to float
+    size_t mapping_size;
+} IslandShared;
+
+// Configures a freshly created island simulation, e.g. solver and early
+// termination settings
+typedef void (*IslandSetupFn)(SimulationState* sim, void* ctx);
+
+// Trains `generations` generations on each of settings->island_count
+// forked processes, each with `threads` worker threads and its own
+// population seeded from `seed` and its index. Every migrate_every
+// generations each island replaces its last `migrants` children with the
+// best genomes of its source island. The topology and all seeds are fixed
+// by `seed`, so runs are reproducible. Returns the shared results once
+// every island has finished, or NULL if islands are not supported here or
+// could not start.
+IslandShared* island_run(const IslandSettings* settings, const SimConfig* config, uint64_t seed, int threads,
+                         float dt, int generations, IslandSetupFn setup, void* ctx);
+void island_release(IslandShared* shared);
+
+static inline const IslandRecord* island_record(const IslandShared* shared, int island, int generation) {
+    return &shared->records[(size_t)island * shared->generations + generation - 1];
+}
+
+#endif // ISLAND_H
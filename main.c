@@ -1,13 +1,396 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL.h>
 #include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "physics.h"
 #include "nn.h"
 #include "genetics.h"
 #include "simulation.h"
+#include "render.h"
+#include "checkpoint.h"
+#include "snapshot.h"
+#include "trajectory.h"
+#include "timer.h"
+
+#define RENDER_FPS 60
+#define DEFAULT_DT (1.0f / 60.0f)
+#define DEFAULT_SUBSTEPS 1
+#define DEFAULT_MAX_STEPS 32
+#define PUBLISH_INTERVAL (1.0 / (2 * RENDER_FPS))
+#define FAST_BATCH_SECONDS PUBLISH_INTERVAL
+#define DEFAULT_TOP_K 100
+#define REPLAY_MIN_SPEED (1.0f / 16.0f)
+#define REPLAY_MAX_SPEED 64.0f
+#define REPLAY_SEEK 10 // Generations skipped by Page Up and Page Down
+
+// The simulation runs on its own thread and only talks to the render
+// thread through the snapshot buffer and these flags
+typedef struct {
+    SimulationState* sim;
+    SnapshotBuffer* snapshots;
+    float dt;      // Fixed physics timestep
+    int substeps;  // Steps per dt of wall-clock time, i.e. playback speed
+    int max_steps; // Cap on steps per catch-up, against the spiral of death
+    atomic_int quit;
+    atomic_int fast; // Step as fast as possible instead of in real time
+} SimulationThread;
+
+static void* simulation_main(void* arg) {
+    SimulationThread* t = (SimulationThread*)arg;
+    double last_time = timer_now();
+    double last_publish = last_time;
+    double accumulator = 0;
+    int generation = t->sim->generation;
+
+    while (!atomic_load(&t->quit)) {
+        double now = timer_now();
+        double elapsed = now - last_time;
+        last_time = now;
+
+        int steps = 0;
+        if (atomic_load(&t->fast)) {
+            // Fixed steps back to back, pausing only to publish
+            accumulator = 0;
+            do {
+                simulation_update(t->sim, t->dt);
+                steps++;
+            } while (timer_now() - now < FAST_BATCH_SECONDS && t->sim->generation == generation);
+        } else {
+            // Fixed-timestep accumulator: sim time advances substeps * dt
+            // for every dt of wall-clock time, always in whole dt steps
+            accumulator += elapsed * t->substeps;
+            while (accumulator >= t->dt && steps < t->max_steps) {
+                simulation_update(t->sim, t->dt);
+                accumulator -= t->dt;
+                steps++;
+            }
+            // Too far behind: drop the backlog rather than fall further behind
+            if (accumulator >= t->dt) accumulator = 0;
+        }
+
+        // Publish at twice the display rate, and always at a new generation
+        if (steps > 0 && (now - last_publish >= PUBLISH_INTERVAL || t->sim->generation != generation)) {
+            snapshot_publish(t->snapshots, t->sim, (float)(accumulator / t->dt));
+            last_publish = now;
+            generation = t->sim->generation;
+        }
+        if (steps == 0) SDL_Delay(1);
+    }
+    return NULL;
+}
+
+// Playback of a trajectory file, one generation's recorded creatures at
+// a time. A generation is decoded whole when it is shown; trajectories
+// that ended early hold their last step.
+typedef struct {
+    const TrajectoryFile* file;
+    int first; // Records [first, first + count) are the shown generation
+    int count;
+    int steps; // Of the longest of them
+    float* frames; // [record][steps][coordinates]
+    size_t frame_capacity;
+    Snapshot snapshot; // Two steps of the shown generation, for render_snapshot
+    double time; // Seconds into the generation
+    float speed; // Recorded seconds per second
+    int paused;
+} Replay;
+
+static void replay_init(Replay* rp, const TrajectoryFile* tf) {
+    const TrajectoryHeader* h = tf->header;
+    size_t plane = (size_t)h->point_count * h->creature_count;
+    rp->file = tf;
+    rp->frames = NULL;
+    rp->frame_capacity = 0;
+    rp->snapshot.creature_count = h->creature_count;
+    rp->snapshot.point_count = h->point_count;
+    rp->snapshot.constraints = tf->constraints;
+    rp->snapshot.constraint_count = h->constraint_count;
+    rp->snapshot.ground = NULL; // Trajectory files do not store the terrain
+    rp->snapshot.x = (float*)calloc(4 * plane, sizeof(float));
+    rp->snapshot.y = rp->snapshot.x + plane;
+    rp->snapshot.old_x = rp->snapshot.y + plane;
+    rp->snapshot.old_y = rp->snapshot.old_x + plane;
+    rp->speed = 1.0f;
+    rp->paused = 0;
+}
+
+// Shows the generation of record `first`, from its start
+static void replay_load(Replay* rp, int first) {
+    const TrajectoryFile* tf = rp->file;
+    int coordinates = 2 * tf->header->point_count;
+    int generation = tf->records[first]->generation;
+    int count = 0, steps = 0;
+    while (first + count < tf->record_count && count < tf->header->creature_count &&
+           tf->records[first + count]->generation == generation) {
+        if (tf->records[first + count]->step_count > steps) steps = tf->records[first + count]->step_count;
+        count++;
+    }
+
+    size_t size = (size_t)count * steps * coordinates;
+    if (size > rp->frame_capacity) {
+        rp->frames = (float*)realloc(rp->frames, size * sizeof(float));
+        rp->frame_capacity = size;
+    }
+    memset(rp->frames, 0, size * sizeof(float));
+    float best = 0;
+    for (int i = 0; i < count; i++) {
+        const TrajectoryRecord* record = tf->records[first + i];
+        float* frames = rp->frames + (size_t)i * steps * coordinates;
+        if (!trajectory_decode(tf, first + i, frames)) {
+            printf("Trajectory of creature %d in generation %d is corrupt\n", record->creature, generation);
+            continue;
+        }
+        for (int s = record->step_count; s < steps; s++) {
+            memcpy(frames + (size_t)s * coordinates, frames + (size_t)(record->step_count - 1) * coordinates,
+                   coordinates * sizeof(float));
+        }
+        if (i == 0 || record->fitness > best) best = record->fitness;
+    }
+
+    rp->first = first;
+    rp->count = count;
+    rp->steps = steps;
+    rp->time = 0;
+    rp->snapshot.slot_count = count;
+    rp->snapshot.active_count = count;
+    rp->snapshot.generation = generation;
+    rp->snapshot.best_fitness = best;
+}
+
+// Shows the first generation at or after `generation`, or the last one
+static void replay_seek(Replay* rp, int generation) {
+    const TrajectoryFile* tf = rp->file;
+    int first = trajectory_find(tf, generation);
+    if (first == tf->record_count) first = trajectory_find(tf, tf->records[tf->record_count - 1]->generation);
+    replay_load(rp, first);
+}
+
+// Fills the snapshot with the steps around rp->time. Returns the alpha
+// to render it with.
+static float replay_frame(Replay* rp) {
+    const TrajectoryHeader* h = rp->file->header;
+    int points = h->point_count;
+    int coordinates = 2 * points;
+    int stride = rp->snapshot.creature_count;
+    // Step j of a trajectory holds the positions after its (j + 1)-th step
+    double position = rp->time / h->dt - 1;
+    if (position < 0) position = 0;
+    if (position > rp->steps - 1) position = rp->steps - 1;
+    int from = (int)position;
+    int to = from + 1 < rp->steps ? from + 1 : from;
+
+    Snapshot* s = &rp->snapshot;
+    for (int i = 0; i < rp->count; i++) {
+        const float* frames = rp->frames + (size_t)i * rp->steps * coordinates;
+        const float* old_frame = frames + (size_t)from * coordinates;
+        const float* frame = frames + (size_t)to * coordinates;
+        for (int p = 0; p < points; p++) {
+            s->old_x[p * stride + i] = old_frame[p];
+            s->old_y[p * stride + i] = old_frame[points + p];
+            s->x[p * stride + i] = frame[p];
+            s->y[p * stride + i] = frame[points + p];
+        }
+    }
+    s->sim_time = (float)rp->time;
+    return (float)(position - from);
+}
+
+// Plays `tf` until the window is closed. Space pauses, Left and Right
+// step through generations, Page Up and Page Down skip REPLAY_SEEK of
+// them, Home and End jump to the first and last, Up and Down double and
+// halve the speed, R restarts the generation and L toggles level of detail.
+static void replay_main(SDL_Window* window, SDL_Renderer* renderer, Renderer* view, const TrajectoryFile* tf,
+                        int from, float speed, int top_k) {
+    Replay rp;
+    replay_init(&rp, tf);
+    rp.speed = speed;
+    replay_seek(&rp, from);
+
+    int quit = 0;
+    SDL_Event e;
+    char title[160], shown_title[160] = "";
+    double last_time = timer_now();
+    while (!quit) {
+        double frame_start = timer_now();
+        while (SDL_PollEvent(&e) != 0) {
+            if (e.type == SDL_QUIT) {
+                quit = 1;
+            } else if (e.type == SDL_KEYDOWN) {
+                int generation = rp.snapshot.generation;
+                int last = tf->records[tf->record_count - 1]->generation;
+                switch (e.key.keysym.sym) {
+                case SDLK_SPACE:
+                    rp.paused = !rp.paused;
+                    break;
+                case SDLK_RIGHT:
+                    replay_seek(&rp, generation + 1);
+                    break;
+                case SDLK_LEFT:
+                    // The generation of the record before this one
+                    replay_seek(&rp, rp.first > 0 ? tf->records[rp.first - 1]->generation : generation);
+                    break;
+                case SDLK_PAGEUP:
+                    replay_seek(&rp, generation + REPLAY_SEEK);
+                    break;
+                case SDLK_PAGEDOWN:
+                    replay_seek(&rp, generation - REPLAY_SEEK);
+                    break;
+                case SDLK_HOME:
+                    replay_seek(&rp, 0);
+                    break;
+                case SDLK_END:
+                    replay_seek(&rp, last);
+                    break;
+                case SDLK_UP:
+                    if (rp.speed < REPLAY_MAX_SPEED) rp.speed *= 2;
+                    break;
+                case SDLK_DOWN:
+                    if (rp.speed > REPLAY_MIN_SPEED) rp.speed /= 2;
+                    break;
+                case SDLK_r:
+                    rp.time = 0;
+                    break;
+                case SDLK_l:
+                    view->top_k = view->top_k > 0 ? 0 : (top_k > 0 ? top_k : DEFAULT_TOP_K);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        // Play on into the next generation at the end of this one
+        double now = timer_now();
+        if (!rp.paused) rp.time += (now - last_time) * rp.speed;
+        last_time = now;
+        if (rp.time >= rp.steps * (double)tf->header->dt) {
+            if (rp.first + rp.count < tf->record_count) {
+                replay_load(&rp, rp.first + rp.count);
+            } else {
+                rp.time = rp.steps * (double)tf->header->dt;
+            }
+        }
+
+        snprintf(title, sizeof(title), "Neural Evolution - Replay | Generation %d | Best: %.2f | %.3gx%s",
+                 rp.snapshot.generation, rp.snapshot.best_fitness, rp.speed, rp.paused ? " | Paused" : "");
+        if (strcmp(title, shown_title) != 0) {
+            SDL_SetWindowTitle(window, title);
+            strcpy(shown_title, title);
+        }
+
+        SDL_SetRenderDrawColor(renderer, 20, 20, 20, 255);
+        SDL_RenderClear(renderer);
+        float alpha = replay_frame(&rp);
+        render_snapshot(view, &rp.snapshot, alpha);
+        SDL_RenderPresent(renderer);
+
+        double frame_time = timer_now() - frame_start;
+        if (frame_time < 1.0 / RENDER_FPS) SDL_Delay((Uint32)((1.0 / RENDER_FPS - frame_time) * 1000.0));
+    }
+    free(rp.frames);
+    free(rp.snapshot.x);
+}
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options] [checkpoint]\n", prog);
+    printf("  --top K          Draw only the K creatures furthest ahead (L toggles)\n");
+    printf("  --dt SECONDS     Fixed physics timestep (default 1/60)\n");
+    printf("  --substeps N     Physics steps per timestep of real time (default %d)\n", DEFAULT_SUBSTEPS);
+    printf("  --max-steps N    Most steps taken at once to catch up (default %d)\n", DEFAULT_MAX_STEPS);
+    printf("  --seed N         Random seed (default: time)\n");
+    printf("  --config PATH    Population and run settings as 'key = value' lines\n");
+    printf("  --population N, --hidden N, --mutation-rate R, --duration S, --chunk N, --memory-budget MB,\n");
+    printf("  --genome f32|f16|i8, --scenarios K, --combine MODE, --quantile Q, --terrain PX, --start-offset PX,\n");
+    printf("  --push V, --mutation-noise N, --elite-fraction F, --leg-force N, --arm-force N\n");
+    printf("                   Override single settings; see walking_headless --help\n");
+    printf("  --replay PATH    Play back a file written by walking_headless --record instead of training\n");
+    printf("  --from GEN       Replay: start at generation GEN\n");
+    printf("  --speed X        Replay: recorded seconds per second (default 1)\n");
+}
 
 int main(int argc, char* argv[]) {
+    const char* checkpoint_path = NULL;
+    int top_k = 0;
+    float dt = DEFAULT_DT;
+    int substeps = DEFAULT_SUBSTEPS;
+    int max_steps = DEFAULT_MAX_STEPS;
+    uint64_t seed = (uint64_t)time(NULL);
+    const char* replay_path = NULL;
+    int replay_from = 0;
+    float replay_speed = 1.0f;
+    SimConfig config;
+    config_defaults(&config);
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--config") == 0 && !config_load(&config, argv[i + 1])) return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (arg[0] != '-') {
+            checkpoint_path = arg;
+            continue;
+        }
+        if (value == NULL) {
+            printf("Missing value for %s\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--top") == 0) {
+            top_k = atoi(value);
+        } else if (strcmp(arg, "--dt") == 0) {
+            dt = (float)atof(value);
+        } else if (strcmp(arg, "--substeps") == 0) {
+            substeps = atoi(value);
+        } else if (strcmp(arg, "--max-steps") == 0) {
+            max_steps = atoi(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--replay") == 0) {
+            replay_path = value;
+        } else if (strcmp(arg, "--from") == 0) {
+            replay_from = atoi(value);
+        } else if (strcmp(arg, "--speed") == 0) {
+            replay_speed = (float)atof(value);
+        } else if (strcmp(arg, "--config") == 0) {
+            // Read above
+        } else if (strncmp(arg, "--", 2) == 0 && config_has_key(arg + 2)) {
+            if (!config_set(&config, arg + 2, value)) return 1;
+        } else {
+            printf("Unknown option %s\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (dt <= 0 || substeps <= 0 || max_steps < substeps || replay_speed <= 0) {
+        printf("dt, substeps and speed must be positive, and max-steps at least substeps\n");
+        return 1;
+    }
+    TrajectoryFile* replay = NULL;
+    if (replay_path != NULL) {
+        replay = trajectory_open(replay_path);
+        if (replay == NULL) return 1;
+        if (replay->record_count == 0) {
+            printf("%s holds no trajectories\n", replay_path);
+            return 1;
+        }
+    }
+    if (checkpoint_path != NULL && !checkpoint_read_config(checkpoint_path, &config)) return 1;
+    MemoryEstimate memory;
+    if (!simulation_fit_memory_budget(&config, 0, &memory)) {
+        printf("%d creatures need %.1f MB, over the %.0f MB memory budget\n", config.population_size,
+               memory.total / (1024.0 * 1024.0), config.memory_budget_mb);
+        return 1;
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
         return 1;
@@ -27,47 +410,108 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (renderer == NULL) {
         printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
         return 1;
     }
 
-    srand(time(NULL));
+    Renderer* view = render_create(renderer);
+    if (view == NULL) return 1;
+    view->top_k = top_k;
+
+    // Replay needs neither a simulation nor its thread
+    if (replay != NULL) {
+        replay_main(window, renderer, view, replay, replay_from, replay_speed, top_k);
+        trajectory_close(replay);
+        render_destroy(view);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 0;
+    }
 
     int quit = 0;
     SDL_Event e;
 
-    SimulationState* sim = simulation_create();
+    // Leave one core to the render thread
+    int threads = pool_cpu_count() > 1 ? pool_cpu_count() - 1 : 1;
 
-    Uint32 last_time = SDL_GetTicks();
+    // An optional checkpoint argument continues a headless training run
+    SimulationState* sim = NULL;
+    if (checkpoint_path != NULL) {
+        sim = checkpoint_resume(checkpoint_path, &config, threads);
+        if (sim == NULL) return 1;
+    } else {
+        sim = simulation_create(&config, seed, threads);
+    }
 
-    while (!quit) {
-        Uint32 current_time = SDL_GetTicks();
-        float dt = (current_time - last_time) / 1000.0f;
-        last_time = current_time;
+    SimulationThread sim_thread;
+    sim_thread.sim = sim;
+    sim_thread.snapshots = snapshot_buffer_create(sim);
+    sim_thread.dt = dt;
+    sim_thread.substeps = substeps;
+    sim_thread.max_steps = max_steps;
+    atomic_init(&sim_thread.quit, 0);
+    atomic_init(&sim_thread.fast, 0);
+    pthread_t sim_handle;
+    if (pthread_create(&sim_handle, NULL, simulation_main, &sim_thread) != 0) {
+        printf("Simulation thread could not be created!\n");
+        return 1;
+    }
+
+    // This thread only draws: frames follow the display (vsync, or
+    // RENDER_FPS without it) and show the newest published snapshot
+    int shown_generation = -1;
+    char title[128];
 
+    while (!quit) {
+        double frame_start = timer_now();
         while (SDL_PollEvent(&e) != 0) {
             if (e.type == SDL_QUIT) {
                 quit = 1;
+            } else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_l) {
+                // L toggles level of detail
+                view->top_k = view->top_k > 0 ? 0 : (top_k > 0 ? top_k : DEFAULT_TOP_K);
+            } else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_f) {
+                // F toggles fast-forward
+                atomic_store(&sim_thread.fast, !atomic_load(&sim_thread.fast));
             }
         }
 
-        // 1. Update simulation
-        simulation_update(sim, dt);
+        const Snapshot* snapshot = snapshot_acquire(sim_thread.snapshots);
+        if (snapshot->generation != shown_generation) {
+            shown_generation = snapshot->generation;
+            snprintf(title, sizeof(title), "Neural Evolution - Walking AI | Generation %d | Best: %.2f",
+                     snapshot->generation, snapshot->best_fitness);
+            SDL_SetWindowTitle(window, title);
+        }
 
-        // 2. Clear screen
+        // 1. Clear screen
         SDL_SetRenderDrawColor(renderer, 20, 20, 20, 255);
         SDL_RenderClear(renderer);
 
-        // 3. Render simulation
-        simulation_render(sim, renderer);
+        // 2. Render the latest simulation snapshot, interpolated to now
+        float alpha = 1.0f;
+        if (!atomic_load(&sim_thread.fast)) {
+            alpha = snapshot->alpha + (float)((timer_now() - snapshot->publish_time) * substeps / dt);
+            if (alpha > 1.0f) alpha = 1.0f;
+        }
+        render_snapshot(view, snapshot, alpha);
 
-        // 4. Update screen
+        // 3. Update screen
         SDL_RenderPresent(renderer);
+
+        // Without vsync, wait out the rest of the frame
+        double frame_time = timer_now() - frame_start;
+        if (frame_time < 1.0 / RENDER_FPS) SDL_Delay((Uint32)((1.0 / RENDER_FPS - frame_time) * 1000.0));
     }
 
+    atomic_store(&sim_thread.quit, 1);
+    pthread_join(sim_handle, NULL);
+    snapshot_buffer_destroy(sim_thread.snapshots);
     simulation_destroy(sim);
+    render_destroy(view);
 
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -0,0 +1,57 @@
+#include "mapped_file.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+int mapped_file_open(const char* path, MappedFile* m) {
+#ifdef _WIN32
+    m->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m->file == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m->file, &size) || size.QuadPart == 0) {
+        CloseHandle(m->file);
+        return 0;
+    }
+    m->size = (size_t)size.QuadPart;
+    m->mapping = CreateFileMappingA(m->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m->mapping == NULL) {
+        CloseHandle(m->file);
+        return 0;
+    }
+    m->data = (const unsigned char*)MapViewOfFile(m->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (m->data == NULL) {
+        CloseHandle(m->mapping);
+        CloseHandle(m->file);
+        return 0;
+    }
+    return 1;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    m->size = (size_t)st.st_size;
+    void* data = mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file alive
+    if (data == MAP_FAILED) return 0;
+    m->data = (const unsigned char*)data;
+    return 1;
+#endif
+}
+
+void mapped_file_close(MappedFile* m) {
+#ifdef _WIN32
+    UnmapViewOfFile(m->data);
+    CloseHandle(m->mapping);
+    CloseHandle(m->file);
+#else
+    munmap((void*)m->data, m->size);
+#endif
+}
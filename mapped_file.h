@@ -0,0 +1,23 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// A whole file mapped read-only into memory
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} MappedFile;
+
+// Returns 0 if the file is missing, empty or cannot be mapped
+int mapped_file_open(const char* path, MappedFile* m);
+void mapped_file_close(MappedFile* m);
+
+#endif // MAPPED_FILE_H
@@ -1,4 +1,5 @@
 #include "nn.h"
+#include "simd.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -8,28 +9,25 @@ static float activation(float x) {
     return tanhf(x);
 }
 
-// Random float between -1 and 1
-static float rand_float() {
-    return ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
-}
-
 NeuralNetwork* nn_create(int input, int hidden, int output) {
     NeuralNetwork* nn = (NeuralNetwork*)malloc(sizeof(NeuralNetwork));
     nn->input_count = input;
     nn->hidden_count = hidden;
     nn->output_count = output;
 
-    nn->weights_ih = (float*)malloc(input * hidden * sizeof(float));
-    nn->weights_ho = (float*)malloc(hidden * output * sizeof(float));
+    nn->weights_ih = (float*)calloc(input * hidden, sizeof(float));
+    nn->weights_ho = (float*)calloc(hidden * output, sizeof(float));
     nn->hidden_outputs = (float*)malloc(hidden * sizeof(float));
-    
-    // Initialize weights randomly
-    for (int i = 0; i < input * hidden; i++) nn->weights_ih[i] = rand_float();
-    for (int i = 0; i < hidden * output; i++) nn->weights_ho[i] = rand_float();
 
     return nn;
 }
 
+// Initialize weights uniformly in [-1, 1)
+void nn_randomize(NeuralNetwork* nn, Rng* rng) {
+    for (int i = 0; i < nn->input_count * nn->hidden_count; i++) nn->weights_ih[i] = rng_symmetric(rng);
+    for (int i = 0; i < nn->hidden_count * nn->output_count; i++) nn->weights_ho[i] = rng_symmetric(rng);
+}
+
 void nn_destroy(NeuralNetwork* nn) {
     free(nn->weights_ih);
     free(nn->weights_ho);
@@ -37,21 +35,24 @@ void nn_destroy(NeuralNetwork* nn) {
     free(nn);
 }
 
-void nn_run(NeuralNetwork* nn, const float* inputs, float* outputs) {
+SIMD_FORCE_INLINE void nn_run_shape(NeuralNetwork* nn, const float* inputs, float* outputs,
+                                    int input_count, int hidden_count, int output_count) {
     // Calculate hidden layer outputs
-    for (int i = 0; i < nn->hidden_count; i++) {
+    for (int i = 0; i < hidden_count; i++) {
         float sum = 0;
-        for (int j = 0; j < nn->input_count; j++) {
-            sum += inputs[j] * nn->weights_ih[j * nn->hidden_count + i];
+        SIMD_UNROLL
+        for (int j = 0; j < input_count; j++) {
+            sum += inputs[j] * nn->weights_ih[j * hidden_count + i];
         }
         nn->hidden_outputs[i] = activation(sum);
     }
 
     // Calculate final outputs
-    for (int i = 0; i < nn->output_count; i++) {
+    for (int i = 0; i < output_count; i++) {
         float sum = 0;
-        for (int j = 0; j < nn->hidden_count; j++) {
-            sum += nn->hidden_outputs[j] * nn->weights_ho[j * nn->output_count + i];
+        SIMD_UNROLL
+        for (int j = 0; j < hidden_count; j++) {
+            sum += nn->hidden_outputs[j] * nn->weights_ho[j * output_count + i];
         }
         outputs[i] = activation(sum);
     }
@@ -72,3 +73,185 @@ void nn_get_weights_flat(NeuralNetwork* nn, float* weights_buffer) {
     memcpy(weights_buffer, nn->weights_ih, w_ih_count * sizeof(float));
     memcpy(&weights_buffer[w_ih_count], nn->weights_ho, w_ho_count * sizeof(float));
 }
+
+NNBatch* nn_batch_create(int network_count, int input, int hidden, int output, GenomeFormat format) {
+    NNBatch* batch = (NNBatch*)malloc(sizeof(NNBatch));
+    batch->input_count = input;
+    batch->hidden_count = hidden;
+    batch->output_count = output;
+    batch->network_count = network_count;
+    batch->stride = simd_pad(network_count);
+    batch->format = format;
+
+    int gene_count = input * hidden + hidden * output;
+    batch->weights = simd_alloc((size_t)batch->stride * gene_count * genome_element_size(format));
+    return batch;
+}
+
+void nn_batch_destroy(NNBatch* batch) {
+    simd_free(batch->weights);
+    free(batch);
+}
+
+static int batch_gene_count(const NNBatch* batch) {
+    return batch->input_count * batch->hidden_count + batch->hidden_count * batch->output_count;
+}
+
+// Slot `index`'s first weight; its weights follow SIMD_LANE_PAD elements apart
+static unsigned char* batch_slot(const NNBatch* batch, int index) {
+    size_t element = genome_element_size(batch->format);
+    size_t block = (size_t)(index / SIMD_LANE_PAD) * batch_gene_count(batch) * SIMD_LANE_PAD;
+    return (unsigned char*)batch->weights + (block + index % SIMD_LANE_PAD) * element;
+}
+
+void nn_batch_load(NNBatch* batch, int index, const NeuralNetwork* nn) {
+    int w_ih_count = batch->input_count * batch->hidden_count;
+    int w_ho_count = batch->hidden_count * batch->output_count;
+    unsigned char* slot = batch_slot(batch, index);
+
+    for (int i = 0; i < w_ih_count; i++) genome_set(batch->format, slot, i * SIMD_LANE_PAD, nn->weights_ih[i]);
+    for (int i = 0; i < w_ho_count; i++) genome_set(batch->format, slot, (w_ih_count + i) * SIMD_LANE_PAD, nn->weights_ho[i]);
+}
+
+void nn_batch_load_genome(NNBatch* batch, int index, const void* genes) {
+    int gene_count = batch_gene_count(batch);
+    unsigned char* slot = batch_slot(batch, index);
+    switch (batch->format) {
+    case GENOME_F16:
+        for (int i = 0; i < gene_count; i++) ((uint16_t*)slot)[i * SIMD_LANE_PAD] = ((const uint16_t*)genes)[i];
+        break;
+    case GENOME_I8:
+        for (int i = 0; i < gene_count; i++) ((int8_t*)slot)[i * SIMD_LANE_PAD] = ((const int8_t*)genes)[i];
+        break;
+    default:
+        for (int i = 0; i < gene_count; i++) ((float*)slot)[i * SIMD_LANE_PAD] = ((const float*)genes)[i];
+        break;
+    }
+}
+
+void nn_batch_swap(NNBatch* batch, int a, int b) {
+    int gene_count = batch_gene_count(batch);
+    size_t element = genome_element_size(batch->format);
+    unsigned char* slot_a = batch_slot(batch, a);
+    unsigned char* slot_b = batch_slot(batch, b);
+    for (int i = 0; i < gene_count; i++) {
+        unsigned char swap[4];
+        size_t offset = (size_t)i * SIMD_LANE_PAD * element;
+        memcpy(swap, slot_a + offset, element);
+        memcpy(slot_a + offset, slot_b + offset, element);
+        memcpy(slot_b + offset, swap, element);
+    }
+}
+
+// SIMD_WIDTH lanes of weight `i` in a block, widened to float. int8
+// codes are left unscaled; see scale_sum().
+SIMD_FORCE_INLINE simd_float load_weights(const unsigned char* block, size_t i, GenomeFormat format) {
+    switch (format) {
+    case GENOME_F16: return simd_load_f16((const uint16_t*)block + i);
+    case GENOME_I8: return simd_load_i8((const int8_t*)block + i);
+    default: return simd_load((const float*)block + i);
+    }
+}
+
+// int8 weights share one scale, so it is applied once per neuron rather
+// than once per weight
+SIMD_FORCE_INLINE simd_float scale_sum(simd_float sum, GenomeFormat format) {
+    return format == GENOME_I8 ? simd_mul(sum, simd_set1(GENOME_I8_SCALE)) : sum;
+}
+
+// Evaluates one SIMD_LANE_PAD block at a time. `in` and `hidden` are
+// scratch rows of input_count and hidden_count vectors.
+SIMD_FORCE_INLINE void nn_batch_run_shape(const NNBatch* batch, int begin, int end, const float* inputs, float* outputs,
+                                          int input_count, int hidden_count, int output_count, GenomeFormat format,
+                                          simd_float* in, simd_float* hidden) {
+    int stride = batch->stride;
+    int gene_count = input_count * hidden_count + hidden_count * output_count;
+    size_t element = genome_element_size(format);
+
+    for (int c = begin; c < end; c += SIMD_LANE_PAD) {
+        const unsigned char* w_ih = (const unsigned char*)batch->weights +
+                                    (size_t)(c / SIMD_LANE_PAD) * gene_count * SIMD_LANE_PAD * element;
+        const unsigned char* w_ho = w_ih + (size_t)input_count * hidden_count * SIMD_LANE_PAD * element;
+
+        for (int lane = 0; lane < SIMD_LANE_PAD; lane += SIMD_WIDTH) {
+            SIMD_UNROLL
+            for (int j = 0; j < input_count; j++) {
+                in[j] = simd_load(&inputs[j * stride + c + lane]);
+            }
+
+            // Same summation order as nn_run()
+            SIMD_UNROLL
+            for (int i = 0; i < hidden_count; i++) {
+                simd_float sum = simd_set1(0);
+                SIMD_UNROLL
+                for (int j = 0; j < input_count; j++) {
+                    sum = simd_add(sum, simd_mul(in[j], load_weights(w_ih, (j * hidden_count + i) * SIMD_LANE_PAD + lane, format)));
+                }
+                hidden[i] = simd_tanh(scale_sum(sum, format));
+            }
+
+            SIMD_UNROLL
+            for (int i = 0; i < output_count; i++) {
+                simd_float sum = simd_set1(0);
+                SIMD_UNROLL
+                for (int j = 0; j < hidden_count; j++) {
+                    sum = simd_add(sum, simd_mul(hidden[j], load_weights(w_ho, (j * output_count + i) * SIMD_LANE_PAD + lane, format)));
+                }
+                simd_store(&outputs[i * stride + c + lane], simd_tanh(scale_sum(sum, format)));
+            }
+        }
+    }
+}
+
+// Instantiates the kernel for each weight format
+#define NN_BATCH_RUN_FORMATS(batch, begin, end, inputs, outputs, I, H, O, in, hidden) \
+    switch ((batch)->format) { \
+    case GENOME_F16: nn_batch_run_shape(batch, begin, end, inputs, outputs, I, H, O, GENOME_F16, in, hidden); break; \
+    case GENOME_I8: nn_batch_run_shape(batch, begin, end, inputs, outputs, I, H, O, GENOME_I8, in, hidden); break; \
+    default: nn_batch_run_shape(batch, begin, end, inputs, outputs, I, H, O, GENOME_F32, in, hidden); break; \
+    }
+
+// One nn_run / nn_batch_run pair per entry of NN_KERNEL_SHAPES
+#define NN_SPECIALIZE(I, H, O) \
+    static void nn_run_##I##_##H##_##O(NeuralNetwork* nn, const float* inputs, float* outputs) { \
+        nn_run_shape(nn, inputs, outputs, I, H, O); \
+    } \
+    static void nn_batch_run_##I##_##H##_##O(const NNBatch* batch, int begin, int end, \
+                                             const float* inputs, float* outputs) { \
+        simd_float in[I]; \
+        simd_float hidden[H]; \
+        NN_BATCH_RUN_FORMATS(batch, begin, end, inputs, outputs, I, H, O, in, hidden) \
+    }
+NN_KERNEL_SHAPES(NN_SPECIALIZE)
+#undef NN_SPECIALIZE
+
+void nn_run(NeuralNetwork* nn, const float* inputs, float* outputs) {
+#define NN_DISPATCH(I, H, O) \
+    if (nn->input_count == I && nn->hidden_count == H && nn->output_count == O) { \
+        nn_run_##I##_##H##_##O(nn, inputs, outputs); \
+        return; \
+    }
+    NN_KERNEL_SHAPES(NN_DISPATCH)
+#undef NN_DISPATCH
+    nn_run_shape(nn, inputs, outputs, nn->input_count, nn->hidden_count, nn->output_count);
+}
+
+void nn_batch_run_generic(const NNBatch* batch, int begin, int end, const float* inputs, float* outputs) {
+    simd_float in[batch->input_count];
+    simd_float hidden[batch->hidden_count];
+    int input_count = batch->input_count;
+    int hidden_count = batch->hidden_count;
+    int output_count = batch->output_count;
+    NN_BATCH_RUN_FORMATS(batch, begin, end, inputs, outputs, input_count, hidden_count, output_count, in, hidden)
+}
+
+void nn_batch_run(const NNBatch* batch, int begin, int end, const float* inputs, float* outputs) {
+#define NN_DISPATCH(I, H, O) \
+    if (batch->input_count == I && batch->hidden_count == H && batch->output_count == O) { \
+        nn_batch_run_##I##_##H##_##O(batch, begin, end, inputs, outputs); \
+        return; \
+    }
+    NN_KERNEL_SHAPES(NN_DISPATCH)
+#undef NN_DISPATCH
+    nn_batch_run_generic(batch, begin, end, inputs, outputs);
+}
@@ -2,7 +2,11 @@
 #define NN_H
 
 #include <stdlib.h>
+#include "rng.h"
+#include "genome.h"
 
+// A network either owns its arrays (nn_create/nn_destroy) or is a view
+// into memory owned by someone else, such as a Population's genome arena.
 typedef struct {
     int input_count;
     int hidden_count;
@@ -14,10 +18,49 @@ typedef struct {
     float* hidden_outputs;
 } NeuralNetwork;
 
+// Controllers for a whole population, evaluated together. Weights are
+// interleaved across networks, [block][weight][lane], so each SIMD lane
+// runs a different network. Weight order within a network matches
+// nn_get_weights_flat(). Weights are stored in `format` and widened to
+// float in registers. Inputs and outputs are packed matrices laid out
+// [neuron][network] with row length `stride`.
+typedef struct {
+    int input_count;
+    int hidden_count;
+    int output_count;
+    int network_count;
+    int stride; // network_count padded to SIMD_LANE_PAD
+    GenomeFormat format;
+
+    void* weights;
+} NNBatch;
+
+// Shapes (inputs, hidden, outputs) that get kernels specialized at
+// compile time, with fully unrolled loops. nn_run and nn_batch_run pick
+// them when a network's shape matches and use generic loops otherwise.
+// Override with e.g. -D'NN_KERNEL_SHAPES(X)=X(8, 16, 4) X(8, 32, 4)'.
+#ifndef NN_KERNEL_SHAPES
+#define NN_KERNEL_SHAPES(X) X(8, 16, 4)
+#endif
+
 NeuralNetwork* nn_create(int input, int hidden, int output);
 void nn_destroy(NeuralNetwork* nn);
+void nn_randomize(NeuralNetwork* nn, Rng* rng);
 void nn_run(NeuralNetwork* nn, const float* inputs, float* outputs);
 void nn_set_weights(NeuralNetwork* nn, float* weights);
 void nn_get_weights_flat(NeuralNetwork* nn, float* weights_buffer);
 
+NNBatch* nn_batch_create(int network_count, int input, int hidden, int output, GenomeFormat format);
+void nn_batch_destroy(NNBatch* batch);
+// Copies the weights of `nn` into slot `index`, rounded to the batch's format
+void nn_batch_load(NNBatch* batch, int index, const NeuralNetwork* nn);
+// Copies a genome already in the batch's format (weights in
+// nn_get_weights_flat() order) into slot `index`
+void nn_batch_load_genome(NNBatch* batch, int index, const void* genes);
+void nn_batch_swap(NNBatch* batch, int a, int b);
+// Evaluates networks [begin, end); both bounds must be multiples of SIMD_LANE_PAD
+void nn_batch_run(const NNBatch* batch, int begin, int end, const float* inputs, float* outputs);
+// nn_batch_run without the specialized kernels, for comparison
+void nn_batch_run_generic(const NNBatch* batch, int begin, int end, const float* inputs, float* outputs);
+
 #endif // NN_H
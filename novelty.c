@@ -0,0 +1,239 @@
+#include "novelty.h"
+#include "profile.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NOVELTY_CHUNK 64 // Queries per parallel task
+
+NoveltyArchive* novelty_archive_create(void) {
+    NoveltyArchive* archive = (NoveltyArchive*)malloc(sizeof(NoveltyArchive));
+    archive->behaviors = NULL;
+    archive->split = NULL;
+    archive->count = 0;
+    archive->capacity = 0;
+    archive->tree_count = 0;
+    return archive;
+}
+
+void novelty_archive_destroy(NoveltyArchive* archive) {
+    free(archive->behaviors);
+    free(archive->split);
+    free(archive);
+}
+
+static void swap_behaviors(Behavior* b, int i, int j) {
+    Behavior swap = b[i];
+    b[i] = b[j];
+    b[j] = swap;
+}
+
+// Rearranges b[lo, hi) so b[nth] holds the value that belongs there in
+// order of dimension `dim`, with no larger values before it and no
+// smaller ones after it. Partitions three ways, since clones of a genome
+// share their behavior.
+static void select_nth(Behavior* b, int lo, int hi, int nth, int dim) {
+    while (hi - lo > 1) {
+        // Median of three as the pivot
+        float x = b[lo].d[dim], y = b[lo + (hi - lo) / 2].d[dim], z = b[hi - 1].d[dim];
+        float pivot = x < y ? (y < z ? y : (x < z ? z : x)) : (x < z ? x : (y < z ? z : y));
+
+        // [lo, less) < pivot, [less, i) == pivot, [more, hi) > pivot
+        int less = lo, i = lo, more = hi;
+        while (i < more) {
+            if (b[i].d[dim] < pivot) {
+                swap_behaviors(b, i++, less++);
+            } else if (b[i].d[dim] > pivot) {
+                swap_behaviors(b, i, --more);
+            } else {
+                i++;
+            }
+        }
+        if (nth < less) {
+            hi = less;
+        } else if (nth >= more) {
+            lo = more;
+        } else {
+            return;
+        }
+    }
+}
+
+// Builds a balanced k-d tree over b[lo, hi) in place: the node of a
+// range is its middle element, which splits the dimension of widest
+// spread, with the halves before and after it as its subtrees
+static void build_tree(Behavior* b, unsigned char* split, int lo, int hi) {
+    while (hi - lo > 1) {
+        float low[NOVELTY_DIMS], high[NOVELTY_DIMS];
+        for (int d = 0; d < NOVELTY_DIMS; d++) low[d] = high[d] = b[lo].d[d];
+        for (int i = lo + 1; i < hi; i++) {
+            for (int d = 0; d < NOVELTY_DIMS; d++) {
+                if (b[i].d[d] < low[d]) low[d] = b[i].d[d];
+                if (b[i].d[d] > high[d]) high[d] = b[i].d[d];
+            }
+        }
+        int dim = 0;
+        for (int d = 1; d < NOVELTY_DIMS; d++) {
+            if (high[d] - low[d] > high[dim] - low[dim]) dim = d;
+        }
+
+        int mid = lo + (hi - lo) / 2;
+        select_nth(b, lo, hi, mid, dim);
+        split[mid] = (unsigned char)dim;
+        build_tree(b, split, lo, mid);
+        lo = mid + 1;
+    }
+    if (hi - lo == 1) split[lo] = 0;
+}
+
+static int tree_end(const NoveltyArchive* archive, int tree) {
+    return tree + 1 < archive->tree_count ? archive->tree_begin[tree + 1] : archive->count;
+}
+
+void novelty_archive_add(NoveltyArchive* archive, const Behavior* behaviors, int count) {
+    if (count <= 0) return;
+    if (archive->count + count > archive->capacity) {
+        int capacity = archive->capacity > 0 ? archive->capacity : 1024;
+        while (capacity < archive->count + count) capacity *= 2;
+        archive->behaviors = (Behavior*)realloc(archive->behaviors, capacity * sizeof(Behavior));
+        archive->split = (unsigned char*)realloc(archive->split, capacity);
+        archive->capacity = capacity;
+    }
+
+    // Archived behaviors belong to no creature of later batches
+    Behavior* added = archive->behaviors + archive->count;
+    memcpy(added, behaviors, count * sizeof(Behavior));
+    for (int i = 0; i < count; i++) added[i].id = -1;
+    archive->tree_begin[archive->tree_count++] = archive->count;
+    archive->count += count;
+
+    // Merge the new tree into the one below while that is less than
+    // twice its size
+    while (archive->tree_count > 1) {
+        int top = archive->tree_count - 1;
+        int below = archive->tree_begin[top] - archive->tree_begin[top - 1];
+        if (below >= 2 * (archive->count - archive->tree_begin[top])) break;
+        archive->tree_count--;
+    }
+    int begin = archive->tree_begin[archive->tree_count - 1];
+    build_tree(archive->behaviors, archive->split, begin, archive->count);
+}
+
+// The k smallest squared distances seen so far, ascending
+typedef struct {
+    float dist2[NOVELTY_MAX_NEIGHBOURS];
+    int count;
+    int k;
+} Nearest;
+
+static inline float nearest_bound(const Nearest* n) {
+    return n->count < n->k ? FLT_MAX : n->dist2[n->k - 1];
+}
+
+static inline void nearest_offer(Nearest* n, float dist2) {
+    if (dist2 >= nearest_bound(n)) return;
+    int i = n->count < n->k ? n->count++ : n->k - 1;
+    while (i > 0 && n->dist2[i - 1] > dist2) {
+        n->dist2[i] = n->dist2[i - 1];
+        i--;
+    }
+    n->dist2[i] = dist2;
+}
+
+static inline float distance2(const Behavior* a, const Behavior* b) {
+    float sum = 0;
+    for (int d = 0; d < NOVELTY_DIMS; d++) {
+        float diff = a->d[d] - b->d[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Offers every behavior of the tree over b[lo, hi) that could be among
+// the k nearest to `q`, nearer subtrees first
+static void search_tree(const Behavior* b, const unsigned char* split, int lo, int hi, const Behavior* q,
+                        Nearest* n) {
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (b[mid].id != q->id) nearest_offer(n, distance2(&b[mid], q));
+        float diff = q->d[split[mid]] - b[mid].d[split[mid]];
+        if (diff < 0) {
+            search_tree(b, split, lo, mid, q, n);
+            lo = mid + 1;
+        } else {
+            search_tree(b, split, mid + 1, hi, q, n);
+            hi = mid;
+        }
+        // The far side only if the splitting plane is nearer than the k-th
+        if (diff * diff >= nearest_bound(n)) return;
+    }
+}
+
+static float mean_distance(const Nearest* n) {
+    if (n->count == 0) return 0;
+    float sum = 0;
+    for (int i = 0; i < n->count; i++) sum += sqrtf(n->dist2[i]);
+    return sum / n->count;
+}
+
+typedef struct {
+    const NoveltyArchive* archive;
+    const Behavior* batch; // As a k-d tree
+    const unsigned char* batch_split;
+    const Behavior* queries;
+    int count;
+    int k;
+    float* novelty;
+} ScoreTask;
+
+static void score_task(void* ctx, int task, int thread) {
+    ScoreTask* t = (ScoreTask*)ctx;
+    const NoveltyArchive* archive = t->archive;
+    int begin = task * NOVELTY_CHUNK;
+    int end = begin + NOVELTY_CHUNK;
+    if (end > t->count) end = t->count;
+    PROFILE_BEGIN(PROF_NOVELTY);
+    for (int i = begin; i < end; i++) {
+        Nearest n = {{0}, 0, t->k};
+        const Behavior* q = &t->queries[i];
+        search_tree(t->batch, t->batch_split, 0, t->count, q, &n);
+        for (int tree = 0; tree < archive->tree_count; tree++) {
+            search_tree(archive->behaviors, archive->split, archive->tree_begin[tree], tree_end(archive, tree), q, &n);
+        }
+        t->novelty[i] = mean_distance(&n);
+    }
+    PROFILE_END(PROF_NOVELTY, end - begin);
+}
+
+void novelty_score(const NoveltyArchive* archive, const Behavior* behaviors, int count, int k, float* novelty,
+                   ThreadPool* pool) {
+    if (k > NOVELTY_MAX_NEIGHBOURS) k = NOVELTY_MAX_NEIGHBOURS;
+    Behavior* batch = (Behavior*)malloc(count * sizeof(Behavior));
+    unsigned char* split = (unsigned char*)malloc(count);
+    memcpy(batch, behaviors, count * sizeof(Behavior));
+    build_tree(batch, split, 0, count);
+
+    ScoreTask task = {archive, batch, split, behaviors, count, k, novelty};
+    int chunks = (count + NOVELTY_CHUNK - 1) / NOVELTY_CHUNK;
+    if (pool != NULL) {
+        pool_run(pool, chunks, score_task, &task);
+    } else {
+        for (int i = 0; i < chunks; i++) score_task(&task, i, 0);
+    }
+    free(batch);
+    free(split);
+}
+
+void novelty_score_brute(const NoveltyArchive* archive, const Behavior* behaviors, int count, int k,
+                         float* novelty) {
+    if (k > NOVELTY_MAX_NEIGHBOURS) k = NOVELTY_MAX_NEIGHBOURS;
+    for (int i = 0; i < count; i++) {
+        Nearest n = {{0}, 0, k};
+        for (int j = 0; j < count; j++) {
+            if (j != i) nearest_offer(&n, distance2(&behaviors[j], &behaviors[i]));
+        }
+        for (int j = 0; j < archive->count; j++) nearest_offer(&n, distance2(&archive->behaviors[j], &behaviors[i]));
+        novelty[i] = mean_distance(&n);
+    }
+}
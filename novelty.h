@@ -0,0 +1,54 @@
+#ifndef NOVELTY_H
+#define NOVELTY_H
+
+#include "threadpool.h"
+
+// Behavior descriptor of one creature: distance walked, mean torso angle
+// and the share of time each foot touched the ground. Each is scaled so
+// one unit is a comparable difference in behavior (simulation.c).
+#define NOVELTY_DIMS 4
+#define NOVELTY_MAX_NEIGHBOURS 64
+
+typedef struct {
+    float d[NOVELTY_DIMS];
+    int id; // Creature the behavior came from, to skip itself in queries
+} Behavior;
+
+typedef struct {
+    int neighbours; // k of the k-NN novelty; 0 turns novelty search off
+    float weight;   // Blend of the selection score: 0 is pure novelty, 1 pure fitness
+    int archive_add; // Most novel behaviors archived per generation
+} NoveltySettings;
+
+// Every behavior archived so far, searchable in sublinear time. The
+// archive is a stack of k-d trees, each stored in place in one segment of
+// `behaviors`. A batch of insertions becomes a new tree on top, which is
+// merged into the tree below while that is less than twice its size. Each
+// tree is thus at least twice as large as the one above it, so there are
+// O(log n) trees and each behavior is rebuilt O(log n) times in all.
+typedef struct {
+    Behavior* behaviors;
+    unsigned char* split; // Per tree node: the dimension it splits
+    int count;
+    int capacity;
+
+    int tree_begin[32]; // Start of each tree, bottom first
+    int tree_count;
+} NoveltyArchive;
+
+NoveltyArchive* novelty_archive_create(void);
+void novelty_archive_destroy(NoveltyArchive* archive);
+// Adds `count` behaviors as one batch
+void novelty_archive_add(NoveltyArchive* archive, const Behavior* behaviors, int count);
+
+// Scores each of `count` behaviors by its mean Euclidean distance to its
+// k nearest neighbours among the archive and the other behaviors of the
+// batch. Queries run in parallel on `pool` when it is not NULL; each
+// score depends only on the data, not on the split of the work.
+void novelty_score(const NoveltyArchive* archive, const Behavior* behaviors, int count, int k, float* novelty,
+                   ThreadPool* pool);
+// The same scores by comparing every pair, as a reference for the benchmark
+void novelty_score_brute(const NoveltyArchive* archive, const Behavior* behaviors, int count, int k,
+                         float* novelty);
+
+#endif // NOVELTY_H
@@ -0,0 +1,447 @@
+#include "optimizer.h"
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define ES_SEED_SALT 0xD1B54A32D192ED03ULL // Keeps ES noise apart from the GA's streams
+#define ES_CHUNK 64         // Creatures per parallel sampling task
+#define ES_MAX_PARTIALS 256 // Partial noise sums, reduced in a fixed order
+
+#define ES_DEFAULT_SIGMA 0.05f
+#define ES_DEFAULT_LEARNING_RATE 0.03f
+#define CMA_DEFAULT_SIGMA 0.3f
+
+#define ADAM_BETA1 0.9
+#define ADAM_BETA2 0.999
+#define ADAM_EPSILON 1e-8
+
+static void run_tasks(ThreadPool* pool, int count, PoolTaskFn fn, void* ctx) {
+    if (pool != NULL) {
+        pool_run(pool, count, fn, ctx);
+    } else {
+        for (int i = 0; i < count; i++) fn(ctx, i, 0);
+    }
+}
+
+static int compare_rank_ascending(const void* a, const void* b) {
+    const CreatureRank* x = (const CreatureRank*)a;
+    const CreatureRank* y = (const CreatureRank*)b;
+    if (x->fitness != y->fitness) return x->fitness < y->fitness ? -1 : 1;
+    return x->index - y->index;
+}
+
+static int compare_rank_descending(const void* a, const void* b) {
+    return compare_rank_ascending(b, a);
+}
+
+// --- Gaussian search distributions, shared by the ES back ends ---
+
+// Noise key of sample `index` in `generation`
+static uint32_t sample_key(const Population* pop, int generation, int index) {
+    Rng rng;
+    rng_seed(&rng, pop->seed ^ ES_SEED_SALT, ((uint64_t)generation << 32) | (uint32_t)index);
+    return rng_next(&rng);
+}
+
+// Writes mean + sign * scale * noise(sample) into the arena. Creature 0 is
+// the mean itself; with `antithetic`, creatures 2p + 1 and 2p + 2 share
+// sample p with opposite signs. Creatures past the last sample also get
+// the mean.
+typedef struct {
+    Population* pop;
+    const float* mean;
+    const float* scale;
+    int antithetic;
+    int sample_count;
+} Sampler;
+
+// Sample of creature `i` and its sign, or -1 for the mean
+static int creature_sample(const Sampler* s, int i, float* sign) {
+    if (i == 0) return -1;
+    int sample = s->antithetic ? (i - 1) / 2 : i - 1;
+    *sign = (s->antithetic && ((i - 1) & 1)) ? -1.0f : 1.0f;
+    return sample < s->sample_count ? sample : -1;
+}
+
+static void sample_task(void* ctx, int task, int thread) {
+    Sampler* s = (Sampler*)ctx;
+    Population* pop = s->pop;
+    int n = pop->gene_count;
+    float noise[n + GA_NOISE_BLOCK];
+
+    int begin = task * ES_CHUNK;
+    int end = begin + ES_CHUNK;
+    if (end > pop->population_size) end = pop->population_size;
+    PROFILE_BEGIN(PROF_BREED);
+    for (int i = begin; i < end; i++) {
+        void* genes = ga_genome(pop, i);
+        float sign;
+        int sample = creature_sample(s, i, &sign);
+        if (sample < 0) {
+            for (int j = 0; j < n; j++) genome_set(pop->format, genes, j, s->mean[j]);
+            continue;
+        }
+        ga_noise(MUTATION_GAUSSIAN, sample_key(pop, pop->generation, sample), noise, n);
+        for (int j = 0; j < n; j++) genome_set(pop->format, genes, j, s->mean[j] + sign * s->scale[j] * noise[j]);
+    }
+    PROFILE_END(PROF_BREED, end - begin);
+}
+
+// Fills the arena with pop->generation's samples and resets fitness
+static void sample_population(Sampler* s, ThreadPool* pool) {
+    Population* pop = s->pop;
+    run_tasks(pool, (pop->population_size + ES_CHUNK - 1) / ES_CHUNK, sample_task, s);
+    for (int i = 0; i < pop->population_size; i++) pop->creatures[i].fitness = 0;
+    pop->best_index = 0;
+}
+
+// Weighted sums of the noise of `count` samples, and optionally of its
+// square. Each partial sum covers a fixed range of samples and they are
+// added up in order, so the result does not depend on the thread count.
+typedef struct {
+    const Population* pop;
+    int generation;
+    const int* samples; // NULL for samples [0, count)
+    const float* weights;
+    int count;
+    int squares;
+    int per_partial;
+    int stride; // gene_count rounded up to GA_NOISE_BLOCK
+    float* partials; // [partial][sum, squares][stride]
+} NoiseSum;
+
+static void noise_sum_task(void* ctx, int task, int thread) {
+    NoiseSum* t = (NoiseSum*)ctx;
+    int n = t->pop->gene_count;
+    float noise[t->stride];
+    float* sum = t->partials + (size_t)task * 2 * t->stride;
+    float* square_sum = sum + t->stride;
+    memset(sum, 0, 2 * t->stride * sizeof(float));
+
+    int begin = task * t->per_partial;
+    int end = begin + t->per_partial;
+    if (end > t->count) end = t->count;
+    for (int k = begin; k < end; k++) {
+        int sample = t->samples != NULL ? t->samples[k] : k;
+        ga_noise(MUTATION_GAUSSIAN, sample_key(t->pop, t->generation, sample), noise, n);
+        float w = t->weights[k];
+        for (int j = 0; j < n; j++) sum[j] += w * noise[j];
+        if (t->squares) {
+            for (int j = 0; j < n; j++) square_sum[j] += w * noise[j] * noise[j];
+        }
+    }
+}
+
+// Leaves the sums in partials[0, stride) and the squares after them
+static void noise_sum(NoiseSum* t, ThreadPool* pool) {
+    int partials = (t->count + ES_CHUNK - 1) / ES_CHUNK;
+    if (partials > ES_MAX_PARTIALS) partials = ES_MAX_PARTIALS;
+    if (partials < 1) partials = 1;
+    t->per_partial = (t->count + partials - 1) / partials;
+    run_tasks(pool, partials, noise_sum_task, t);
+    for (int p = 1; p < partials; p++) {
+        const float* part = t->partials + (size_t)p * 2 * t->stride;
+        for (int j = 0; j < 2 * t->stride; j++) t->partials[j] += part[j];
+    }
+}
+
+static int noise_stride(const Population* pop) {
+    return (pop->gene_count + GA_NOISE_BLOCK - 1) / GA_NOISE_BLOCK * GA_NOISE_BLOCK;
+}
+
+static float* alloc_partials(const Population* pop) {
+    return (float*)malloc((size_t)ES_MAX_PARTIALS * 2 * noise_stride(pop) * sizeof(float));
+}
+
+// --- Genetic algorithm ---
+
+static void* ga_create(Population* pop, const OptimizerSettings* settings, ThreadPool* pool) {
+    return pop; // All state lives in the Population
+}
+
+static void ga_destroy(void* impl) {
+}
+
+static void ga_optimizer_evolve(void* impl, Population* pop, ThreadPool* pool) {
+    ga_evolve(pop, pool);
+}
+
+static const OptimizerOps ga_ops = {"ga", ga_create, ga_destroy, ga_optimizer_evolve};
+
+// --- OpenAI-ES: Salimans et al. 2017 ---
+
+typedef struct {
+    float sigma;
+    float learning_rate;
+    float* mean;
+    float* scale; // sigma for every gene
+    float* adam_m;
+    float* adam_v;
+    int step;
+    float* weights; // Per antithetic pair
+    float* partials;
+} OpenAIES;
+
+static void* openai_es_create(Population* pop, const OptimizerSettings* settings, ThreadPool* pool) {
+    int n = pop->gene_count;
+    OpenAIES* es = (OpenAIES*)malloc(sizeof(OpenAIES));
+    es->sigma = settings->sigma > 0 ? settings->sigma : ES_DEFAULT_SIGMA;
+    es->learning_rate = settings->learning_rate > 0 ? settings->learning_rate : ES_DEFAULT_LEARNING_RATE;
+    es->mean = (float*)malloc(n * sizeof(float));
+    es->scale = (float*)malloc(n * sizeof(float));
+    es->adam_m = (float*)calloc(n, sizeof(float));
+    es->adam_v = (float*)calloc(n, sizeof(float));
+    es->step = 0;
+    es->weights = (float*)malloc((pop->population_size / 2 + 1) * sizeof(float));
+    es->partials = alloc_partials(pop);
+    ga_decode_genome(pop, pop->best_index, es->mean);
+    for (int j = 0; j < n; j++) es->scale[j] = es->sigma;
+
+    Sampler sampler = {pop, es->mean, es->scale, 1, (pop->population_size - 1) / 2};
+    sample_population(&sampler, pool);
+    return es;
+}
+
+static void openai_es_destroy(void* impl) {
+    OpenAIES* es = (OpenAIES*)impl;
+    free(es->mean);
+    free(es->scale);
+    free(es->adam_m);
+    free(es->adam_v);
+    free(es->weights);
+    free(es->partials);
+    free(es);
+}
+
+static void openai_es_evolve(void* impl, Population* pop, ThreadPool* pool) {
+    OpenAIES* es = (OpenAIES*)impl;
+    int n = pop->gene_count;
+    int pairs = (pop->population_size - 1) / 2;
+
+    if (pairs > 0) {
+        // Fitness shaping: centered ranks in [-0.5, 0.5] of the perturbed
+        // creatures; each pair's weight is the difference of its two
+        PROFILE_BEGIN(PROF_SELECT);
+        int count = 2 * pairs;
+        for (int k = 0; k < count; k++) {
+            pop->ranks[k].fitness = pop->creatures[k + 1].fitness;
+            pop->ranks[k].index = k + 1;
+        }
+        qsort(pop->ranks, count, sizeof(CreatureRank), compare_rank_ascending);
+        memset(es->weights, 0, pairs * sizeof(float));
+        for (int r = 0; r < count; r++) {
+            int i = pop->ranks[r].index;
+            float utility = (float)r / (count - 1) - 0.5f;
+            es->weights[(i - 1) / 2] += ((i - 1) & 1) ? -utility : utility;
+        }
+        PROFILE_END(PROF_SELECT, count);
+
+        PROFILE_BEGIN(PROF_BREED);
+        NoiseSum sum = {pop, pop->generation, NULL, es->weights, pairs, 0, 0, noise_stride(pop), es->partials};
+        noise_sum(&sum, pool);
+
+        // Adam ascent along the estimated gradient
+        es->step++;
+        double correction1 = 1.0 - pow(ADAM_BETA1, es->step);
+        double correction2 = 1.0 - pow(ADAM_BETA2, es->step);
+        for (int j = 0; j < n; j++) {
+            double gradient = es->partials[j] / (count * es->sigma);
+            es->adam_m[j] = (float)(ADAM_BETA1 * es->adam_m[j] + (1.0 - ADAM_BETA1) * gradient);
+            es->adam_v[j] = (float)(ADAM_BETA2 * es->adam_v[j] + (1.0 - ADAM_BETA2) * gradient * gradient);
+            double step = (es->adam_m[j] / correction1) / (sqrt(es->adam_v[j] / correction2) + ADAM_EPSILON);
+            es->mean[j] += (float)(es->learning_rate * step);
+        }
+        PROFILE_END(PROF_BREED, pairs);
+    }
+
+    // Every creature counts, so the bound rule may not retire anyone
+    pop->elite_threshold = -INFINITY;
+    pop->generation++;
+    Sampler sampler = {pop, es->mean, es->scale, 1, pairs};
+    sample_population(&sampler, pool);
+}
+
+static const OptimizerOps openai_es_ops = {"es", openai_es_create, openai_es_destroy, openai_es_evolve};
+
+// --- sep-CMA-ES: Ros and Hansen 2008 ---
+
+typedef struct {
+    int lambda; // Samples per generation
+    int mu;     // Samples selected
+    float* recombination; // mu weights, fittest first
+    double mu_eff;
+    double c_sigma, d_sigma, c_c, c_1, c_mu, chi_n;
+
+    float sigma;
+    float* mean;
+    float* variance; // Diagonal of C
+    float* scale;    // sigma * sqrt(variance)
+    float* p_sigma;
+    float* p_c;
+    int step;
+
+    int* samples;
+    float* partials;
+} SepCMA;
+
+static void* sep_cma_create(Population* pop, const OptimizerSettings* settings, ThreadPool* pool) {
+    int n = pop->gene_count;
+    SepCMA* cma = (SepCMA*)malloc(sizeof(SepCMA));
+    cma->lambda = pop->population_size - 1;
+    cma->mu = cma->lambda / 2 > 0 ? cma->lambda / 2 : 1;
+    cma->recombination = (float*)malloc(cma->mu * sizeof(float));
+    double total = 0, squares = 0;
+    for (int i = 0; i < cma->mu; i++) total += log(cma->mu + 0.5) - log(i + 1.0);
+    for (int i = 0; i < cma->mu; i++) {
+        double w = (log(cma->mu + 0.5) - log(i + 1.0)) / total;
+        cma->recombination[i] = (float)w;
+        squares += w * w;
+    }
+    cma->mu_eff = 1.0 / squares;
+
+    // Default strategy parameters; the diagonal model learns (n + 2) / 3
+    // times faster than the full one
+    double mu_eff = cma->mu_eff;
+    cma->c_sigma = (mu_eff + 2) / (n + mu_eff + 5);
+    cma->d_sigma = 1 + 2 * fmax(0, sqrt((mu_eff - 1) / (n + 1)) - 1) + cma->c_sigma;
+    cma->c_c = (4 + mu_eff / n) / (n + 4 + 2 * mu_eff / n);
+    double c_1 = 2 / ((n + 1.3) * (n + 1.3) + mu_eff);
+    double c_mu = 2 * (mu_eff - 2 + 1 / mu_eff) / ((n + 2.0) * (n + 2.0) + mu_eff);
+    cma->c_1 = fmin(1, c_1 * (n + 2) / 3);
+    cma->c_mu = fmin(1 - cma->c_1, c_mu * (n + 2) / 3);
+    cma->chi_n = sqrt(n) * (1 - 1.0 / (4 * n) + 1.0 / (21.0 * n * n));
+
+    cma->sigma = settings->sigma > 0 ? settings->sigma : CMA_DEFAULT_SIGMA;
+    cma->mean = (float*)malloc(n * sizeof(float));
+    cma->variance = (float*)malloc(n * sizeof(float));
+    cma->scale = (float*)malloc(n * sizeof(float));
+    cma->p_sigma = (float*)calloc(n, sizeof(float));
+    cma->p_c = (float*)calloc(n, sizeof(float));
+    cma->step = 0;
+    cma->samples = (int*)malloc(cma->mu * sizeof(int));
+    cma->partials = alloc_partials(pop);
+    ga_decode_genome(pop, pop->best_index, cma->mean);
+    for (int j = 0; j < n; j++) {
+        cma->variance[j] = 1;
+        cma->scale[j] = cma->sigma;
+    }
+
+    Sampler sampler = {pop, cma->mean, cma->scale, 0, cma->lambda};
+    sample_population(&sampler, pool);
+    return cma;
+}
+
+static void sep_cma_destroy(void* impl) {
+    SepCMA* cma = (SepCMA*)impl;
+    free(cma->recombination);
+    free(cma->mean);
+    free(cma->variance);
+    free(cma->scale);
+    free(cma->p_sigma);
+    free(cma->p_c);
+    free(cma->samples);
+    free(cma->partials);
+    free(cma);
+}
+
+static void sep_cma_evolve(void* impl, Population* pop, ThreadPool* pool) {
+    SepCMA* cma = (SepCMA*)impl;
+    int n = pop->gene_count;
+
+    if (cma->lambda >= 2) {
+        // The mu fittest samples, fittest first
+        PROFILE_BEGIN(PROF_SELECT);
+        for (int k = 0; k < cma->lambda; k++) {
+            pop->ranks[k].fitness = pop->creatures[k + 1].fitness;
+            pop->ranks[k].index = k;
+        }
+        ga_select_top(pop->ranks, cma->lambda, cma->mu);
+        qsort(pop->ranks, cma->mu, sizeof(CreatureRank), compare_rank_descending);
+        for (int i = 0; i < cma->mu; i++) cma->samples[i] = pop->ranks[i].index;
+        // Samples below the selection get no weight, so the bound rule may
+        // retire them
+        pop->elite_threshold = pop->ranks[cma->mu - 1].fitness;
+        PROFILE_END(PROF_SELECT, cma->lambda);
+
+        PROFILE_BEGIN(PROF_BREED);
+        NoiseSum sum = {pop, pop->generation, cma->samples, cma->recombination, cma->mu, 1, 0, noise_stride(pop),
+                        cma->partials};
+        noise_sum(&sum, pool);
+        const float* z_w = cma->partials;
+        const float* zz_w = cma->partials + sum.stride;
+
+        // Mean, then the evolution paths in isotropic (z) and scaled (y) space
+        double path_sigma = sqrt(cma->c_sigma * (2 - cma->c_sigma) * cma->mu_eff);
+        double norm = 0;
+        for (int j = 0; j < n; j++) {
+            float y_w = sqrtf(cma->variance[j]) * z_w[j];
+            cma->mean[j] += cma->sigma * y_w;
+            cma->p_sigma[j] = (float)((1 - cma->c_sigma) * cma->p_sigma[j] + path_sigma * z_w[j]);
+            norm += (double)cma->p_sigma[j] * cma->p_sigma[j];
+        }
+        norm = sqrt(norm);
+        cma->step++;
+        double stalled = norm / sqrt(1 - pow(1 - cma->c_sigma, 2.0 * cma->step)) / cma->chi_n;
+        int h_sigma = stalled < 1.4 + 2.0 / (n + 1);
+        double path_c = h_sigma * sqrt(cma->c_c * (2 - cma->c_c) * cma->mu_eff);
+        double lost = (1 - h_sigma) * cma->c_c * (2 - cma->c_c);
+
+        // Rank-one and rank-mu updates of the diagonal: the weighted y^2 is
+        // variance times the weighted z^2
+        for (int j = 0; j < n; j++) {
+            double c = cma->variance[j];
+            double y_w = sqrt(c) * z_w[j];
+            cma->p_c[j] = (float)((1 - cma->c_c) * cma->p_c[j] + path_c * y_w);
+            double p_c = cma->p_c[j];
+            c = (1 - cma->c_1 - cma->c_mu) * c + cma->c_1 * (p_c * p_c + lost * c) + cma->c_mu * c * zz_w[j];
+            cma->variance[j] = (float)c;
+        }
+        cma->sigma *= (float)exp(cma->c_sigma / cma->d_sigma * (norm / cma->chi_n - 1));
+        for (int j = 0; j < n; j++) cma->scale[j] = cma->sigma * sqrtf(cma->variance[j]);
+        PROFILE_END(PROF_BREED, cma->mu);
+    }
+
+    pop->generation++;
+    Sampler sampler = {pop, cma->mean, cma->scale, 0, cma->lambda};
+    sample_population(&sampler, pool);
+}
+
+static const OptimizerOps sep_cma_ops = {"cma", sep_cma_create, sep_cma_destroy, sep_cma_evolve};
+
+// --- Interface ---
+
+static const OptimizerOps* const optimizer_ops[] = {&ga_ops, &openai_es_ops, &sep_cma_ops};
+
+Optimizer* optimizer_create(Population* pop, const OptimizerSettings* settings, ThreadPool* pool) {
+    const OptimizerOps* ops = optimizer_ops[settings->kind];
+    Optimizer* opt = (Optimizer*)malloc(sizeof(Optimizer));
+    opt->settings = *settings;
+    opt->ops = ops;
+    opt->impl = ops->create(pop, settings, pool);
+    opt->pop = pop;
+    return opt;
+}
+
+void optimizer_destroy(Optimizer* opt) {
+    opt->ops->destroy(opt->impl);
+    free(opt);
+}
+
+void optimizer_evolve(Optimizer* opt, ThreadPool* pool) {
+    opt->ops->evolve(opt->impl, opt->pop, pool);
+}
+
+const char* optimizer_name(OptimizerKind kind) {
+    return optimizer_ops[kind]->name;
+}
+
+int optimizer_parse(const char* name, OptimizerKind* kind) {
+    for (int i = 0; i < (int)(sizeof(optimizer_ops) / sizeof(optimizer_ops[0])); i++) {
+        if (strcmp(name, optimizer_ops[i]->name) == 0) {
+            *kind = (OptimizerKind)i;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "genetics.h"
+#include "threadpool.h"
+
+typedef enum {
+    OPTIMIZER_GA,         // ga_evolve: elitism, crossover and mutation
+    OPTIMIZER_OPENAI_ES,  // Antithetic perturbations of one mean, rank-shaped gradient steps with Adam
+    OPTIMIZER_SEP_CMA_ES  // CMA-ES with a diagonal covariance matrix
+} OptimizerKind;
+
+typedef struct {
+    OptimizerKind kind;
+    float sigma;         // ES: initial noise scale; 0 for the default
+    float learning_rate; // OpenAI-ES: Adam step size; 0 for the default
+} OptimizerSettings;
+
+// Proposes the genomes of each generation and learns from their fitness.
+// Every back end works on a Population: it writes the genomes to evaluate
+// into the arena and reads their fitness from pop->creatures, so the
+// simulation evaluates all of them the same way.
+typedef struct {
+    const char* name;
+    // Sets up the back end's state and writes the first generation to
+    // evaluate into the arena, replacing what is there
+    void* (*create)(Population* pop, const OptimizerSettings* settings, ThreadPool* pool);
+    void (*destroy)(void* impl);
+    // Learns from the evaluated generation and replaces it with the next
+    // one; bumps pop->generation
+    void (*evolve)(void* impl, Population* pop, ThreadPool* pool);
+} OptimizerOps;
+
+typedef struct {
+    OptimizerSettings settings;
+    const OptimizerOps* ops;
+    void* impl;
+    Population* pop;
+} Optimizer;
+
+// The ES back ends start from the genome of pop->best_index and keep their
+// current mean in creature 0, which thus remains the genome to play back
+Optimizer* optimizer_create(Population* pop, const OptimizerSettings* settings, ThreadPool* pool);
+void optimizer_destroy(Optimizer* opt);
+// Breeds the next generation from creature fitness, like ga_evolve. The
+// pool may be NULL.
+void optimizer_evolve(Optimizer* opt, ThreadPool* pool);
+const char* optimizer_name(OptimizerKind kind);
+// Parses "ga", "es" or "cma". Returns 0 for an unknown name.
+int optimizer_parse(const char* name, OptimizerKind* kind);
+
+#endif // OPTIMIZER_H
@@ -1,6 +1,8 @@
 #include "physics.h"
+#include "simd.h"
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define GRAVITY 9.8f
 
@@ -61,3 +63,309 @@ void satisfy_constraint(Constraint* c) {
         c->p2->position.y -= correction.y;
     }
 }
+
+PhysicsStore* physics_store_create(int creature_count, int point_count, const float* masses,
+                                   const ConstraintDef* constraints, int constraint_count) {
+    PhysicsStore* store = (PhysicsStore*)malloc(sizeof(PhysicsStore));
+    store->creature_count = creature_count;
+    store->stride = simd_pad(creature_count);
+    store->point_count = point_count;
+    store->constraint_count = constraint_count;
+
+    // One block for all six state arrays
+    size_t array_len = (size_t)point_count * store->stride;
+    float* block = (float*)simd_alloc(6 * array_len * sizeof(float));
+    store->x = block;
+    store->y = block + array_len;
+    store->old_x = block + 2 * array_len;
+    store->old_y = block + 3 * array_len;
+    store->acc_x = block + 4 * array_len;
+    store->acc_y = block + 5 * array_len;
+
+    store->inv_mass = (float*)malloc(point_count * sizeof(float));
+    for (int p = 0; p < point_count; p++) {
+        store->inv_mass[p] = masses[p] == 0.0f ? 0.0f : 1.0f / masses[p];
+    }
+    store->constraints = (ConstraintDef*)malloc(constraint_count * sizeof(ConstraintDef));
+    memcpy(store->constraints, constraints, constraint_count * sizeof(ConstraintDef));
+    store->ground = NULL;
+    store->terrain = (int*)calloc(store->stride, sizeof(int));
+    return store;
+}
+
+void physics_store_destroy(PhysicsStore* store) {
+    simd_free(store->x);
+    free(store->inv_mass);
+    free(store->constraints);
+    free(store->terrain);
+    free(store);
+}
+
+void physics_store_set_pose(PhysicsStore* store, int creature, const Vec2D* positions) {
+    for (int p = 0; p < store->point_count; p++) {
+        int i = PHYS_INDEX(store, p, creature);
+        store->x[i] = store->old_x[i] = positions[p].x;
+        store->y[i] = store->old_y[i] = positions[p].y;
+        store->acc_x[i] = store->acc_y[i] = 0;
+    }
+}
+
+// Exchanges the complete state of two creatures
+void physics_store_swap(PhysicsStore* store, int a, int b) {
+    float* arrays[6] = {store->x, store->y, store->old_x, store->old_y, store->acc_x, store->acc_y};
+    for (int k = 0; k < 6; k++) {
+        for (int p = 0; p < store->point_count; p++) {
+            float* v = arrays[k] + PHYS_INDEX(store, p, 0);
+            float swap = v[a];
+            v[a] = v[b];
+            v[b] = swap;
+        }
+    }
+    int terrain = store->terrain[a];
+    store->terrain[a] = store->terrain[b];
+    store->terrain[b] = terrain;
+}
+
+Heightfield* heightfield_create(float origin, float cell_size, int cell_count, int terrain_count, float height) {
+    Heightfield* field = (Heightfield*)malloc(sizeof(Heightfield));
+    field->origin = origin;
+    field->inv_cell = 1.0f / cell_size;
+    field->cell_count = cell_count;
+    field->terrain_count = terrain_count;
+    field->heights = (float*)malloc((size_t)terrain_count * cell_count * sizeof(float));
+    for (size_t i = 0; i < (size_t)terrain_count * cell_count; i++) field->heights[i] = height;
+    return field;
+}
+
+void heightfield_destroy(Heightfield* field) {
+    if (field == NULL) return;
+    free(field->heights);
+    free(field);
+}
+
+// Ground under each lane of the block at `c`, whose new x positions are
+// already stored. The heightfield has no SIMD gather, so lanes look up
+// their ground one by one.
+static simd_float ground_block(const PhysicsStore* store, const float* x, int c) {
+    float ground[SIMD_WIDTH];
+    for (int lane = 0; lane < SIMD_WIDTH; lane++) {
+        ground[lane] = heightfield_at(store->ground, store->terrain[c + lane], x[c + lane]);
+    }
+    return simd_load(ground);
+}
+
+// Verlet step, gravity and ground clamp for every point. Mirrors
+// update_point_mass() lane by lane.
+void physics_store_integrate(PhysicsStore* store, int begin, int end, float dt, float gravity, float ground_y) {
+    simd_float dt2 = simd_set1(dt * dt);
+    simd_float ground = simd_set1(ground_y);
+    simd_float zero = simd_set1(0.0f);
+
+    for (int p = 0; p < store->point_count; p++) {
+        int base = PHYS_INDEX(store, p, 0);
+        float* x = store->x + base;
+        float* y = store->y + base;
+        float* old_x = store->old_x + base;
+        float* old_y = store->old_y + base;
+        float* acc_x = store->acc_x + base;
+        float* acc_y = store->acc_y + base;
+
+        if (store->inv_mass[p] == 0.0f) {
+            // Static point: only the ground clamp applies
+            for (int c = begin; c < end; c += SIMD_WIDTH) {
+                simd_float floor_y = store->ground != NULL ? ground_block(store, x, c) : ground;
+                simd_store(&y[c], simd_min(simd_load(&y[c]), floor_y));
+            }
+            continue;
+        }
+
+        simd_float g = simd_set1(gravity * store->inv_mass[p]);
+        for (int c = begin; c < end; c += SIMD_WIDTH) {
+            simd_float px = simd_load(&x[c]);
+            simd_float py = simd_load(&y[c]);
+            simd_float vx = simd_sub(px, simd_load(&old_x[c]));
+            simd_float vy = simd_sub(py, simd_load(&old_y[c]));
+            simd_float ax = simd_load(&acc_x[c]);
+            simd_float ay = simd_add(simd_load(&acc_y[c]), g);
+
+            simd_store(&old_x[c], px);
+            simd_store(&old_y[c], py);
+            px = simd_add(px, simd_add(vx, simd_mul(ax, dt2)));
+            py = simd_add(py, simd_add(vy, simd_mul(ay, dt2)));
+            simd_store(&x[c], px);
+            simd_float floor_y = store->ground != NULL ? ground_block(store, x, c) : ground;
+            simd_store(&y[c], simd_min(py, floor_y));
+            simd_store(&acc_x[c], zero);
+            simd_store(&acc_y[c], zero);
+        }
+    }
+}
+
+// Gauss-Seidel sweeps over the shared constraint table. Mirrors
+// satisfy_constraint() lane by lane; each block of creatures runs all
+// sweeps while its points are still in L1.
+SIMD_FORCE_INLINE void solve_fixed_shape(PhysicsStore* store, int begin, int end, int iterations,
+                                         int constraint_count) {
+    simd_float half = simd_set1(0.5f);
+    simd_float epsilon = simd_set1(0.0001f);
+
+    for (int c = begin; c < end; c += SIMD_WIDTH) {
+        for (int it = 0; it < iterations; it++) {
+            SIMD_UNROLL
+            for (int k = 0; k < constraint_count; k++) {
+                const ConstraintDef* def = &store->constraints[k];
+                int i1 = PHYS_INDEX(store, def->p1, c);
+                int i2 = PHYS_INDEX(store, def->p2, c);
+
+                simd_float x1 = simd_load(&store->x[i1]);
+                simd_float y1 = simd_load(&store->y[i1]);
+                simd_float x2 = simd_load(&store->x[i2]);
+                simd_float y2 = simd_load(&store->y[i2]);
+
+                simd_float dx = simd_sub(x2, x1);
+                simd_float dy = simd_sub(y2, y1);
+                simd_float length = simd_sqrt(simd_add(simd_mul(dx, dx), simd_mul(dy, dy)));
+                length = simd_replace_zero(length, epsilon);
+
+                simd_float difference = simd_div(simd_sub(length, simd_set1(def->target_length)), length);
+                simd_float cx = simd_mul(simd_mul(dx, half), difference);
+                simd_float cy = simd_mul(simd_mul(dy, half), difference);
+
+                if (store->inv_mass[def->p1] != 0.0f) {
+                    simd_store(&store->x[i1], simd_add(x1, cx));
+                    simd_store(&store->y[i1], simd_add(y1, cy));
+                }
+                if (store->inv_mass[def->p2] != 0.0f) {
+                    simd_store(&store->x[i2], simd_sub(x2, cx));
+                    simd_store(&store->y[i2], simd_sub(y2, cy));
+                }
+            }
+        }
+    }
+}
+
+// XPBD sweeps, or fixed sweeps with the approximate length. w1, w2,
+// inv_denominator and lambda are scratch of constraint_count entries.
+SIMD_FORCE_INLINE int solve_xpbd_shape(PhysicsStore* store, int begin, int end, float dt,
+                                       const SolverSettings* settings, int constraint_count,
+                                       float* w1, float* w2, float* inv_denominator, simd_float* lambda) {
+    // Per-constraint constants of the XPBD update. Fixed sweeps with the
+    // approximate length run here as rigid XPBD that never converges early.
+    int n = constraint_count;
+    int fixed = settings->mode == SOLVER_FIXED;
+    float alpha_tilde = fixed ? 0.0f : settings->compliance / (dt * dt);
+    for (int k = 0; k < n; k++) {
+        const ConstraintDef* def = &store->constraints[k];
+        w1[k] = store->inv_mass[def->p1];
+        w2[k] = store->inv_mass[def->p2];
+        float denominator = w1[k] + w2[k] + alpha_tilde;
+        inv_denominator[k] = denominator > 0 ? 1.0f / denominator : 0.0f;
+    }
+
+    simd_float zero = simd_set1(0.0f);
+    simd_float epsilon = simd_set1(0.0001f);
+    simd_float tolerance = simd_set1(fixed ? -1.0f : settings->tolerance);
+    simd_float alpha = simd_set1(alpha_tilde);
+    int sweeps = 0;
+
+    for (int c = begin; c < end; c += SIMD_WIDTH) {
+        SIMD_UNROLL
+        for (int k = 0; k < n; k++) lambda[k] = zero;
+        // 1.0 in lanes still converging. A lane stops on its own error
+        // alone, so the result never depends on its neighbours.
+        simd_float active = simd_set1(1.0f);
+
+        for (int it = 0; it < settings->iterations; it++) {
+            simd_float residual = zero;
+            SIMD_UNROLL
+            for (int k = 0; k < n; k++) {
+                const ConstraintDef* def = &store->constraints[k];
+                int i1 = PHYS_INDEX(store, def->p1, c);
+                int i2 = PHYS_INDEX(store, def->p2, c);
+                float target = def->target_length;
+
+                simd_float x1 = simd_load(&store->x[i1]);
+                simd_float y1 = simd_load(&store->y[i1]);
+                simd_float x2 = simd_load(&store->x[i2]);
+                simd_float y2 = simd_load(&store->y[i2]);
+
+                simd_float dx = simd_sub(x2, x1);
+                simd_float dy = simd_sub(y2, y1);
+                simd_float squared = simd_add(simd_mul(dx, dx), simd_mul(dy, dy));
+                simd_float length;
+                if (settings->approx_sqrt) {
+                    // Tangent of sqrt at target^2: never below the true
+                    // length, so corrections cannot overshoot
+                    length = simd_mul(simd_add(squared, simd_set1(target * target)), simd_set1(0.5f / target));
+                } else {
+                    length = simd_replace_zero(simd_sqrt(squared), epsilon);
+                }
+                simd_float error = simd_sub(length, simd_set1(target));
+                residual = simd_max(residual, simd_max(error, simd_sub(zero, error)));
+
+                // dlambda = (-C - alpha * lambda) / (w1 + w2 + alpha)
+                simd_float dlambda = simd_mul(simd_sub(simd_sub(zero, error), simd_mul(alpha, lambda[k])),
+                                              simd_set1(inv_denominator[k]));
+                dlambda = simd_mul(dlambda, active);
+                lambda[k] = simd_add(lambda[k], dlambda);
+
+                simd_float scale = simd_div(dlambda, length);
+                simd_float cx = simd_mul(dx, scale);
+                simd_float cy = simd_mul(dy, scale);
+                if (w1[k] != 0.0f) {
+                    simd_store(&store->x[i1], simd_sub(x1, simd_mul(cx, simd_set1(w1[k]))));
+                    simd_store(&store->y[i1], simd_sub(y1, simd_mul(cy, simd_set1(w1[k]))));
+                }
+                if (w2[k] != 0.0f) {
+                    simd_store(&store->x[i2], simd_add(x2, simd_mul(cx, simd_set1(w2[k]))));
+                    simd_store(&store->y[i2], simd_add(y2, simd_mul(cy, simd_set1(w2[k]))));
+                }
+            }
+            sweeps++;
+
+            active = simd_mul(active, simd_less(tolerance, residual));
+            if (!simd_any(active)) break;
+        }
+    }
+    return sweeps;
+}
+
+// Fixed and XPBD solvers for each entry of PHYSICS_KERNEL_CONSTRAINTS
+#define PHYSICS_SPECIALIZE(C) \
+    static void solve_fixed_##C(PhysicsStore* store, int begin, int end, int iterations) { \
+        solve_fixed_shape(store, begin, end, iterations, C); \
+    } \
+    static int solve_xpbd_##C(PhysicsStore* store, int begin, int end, float dt, const SolverSettings* settings) { \
+        float w1[C], w2[C], inv_denominator[C]; \
+        simd_float lambda[C]; \
+        return solve_xpbd_shape(store, begin, end, dt, settings, C, w1, w2, inv_denominator, lambda); \
+    }
+PHYSICS_KERNEL_CONSTRAINTS(PHYSICS_SPECIALIZE)
+#undef PHYSICS_SPECIALIZE
+
+void physics_store_solve_constraints(PhysicsStore* store, int begin, int end, int iterations) {
+#define PHYSICS_DISPATCH(C) \
+    if (store->constraint_count == C) { \
+        solve_fixed_##C(store, begin, end, iterations); \
+        return; \
+    }
+    PHYSICS_KERNEL_CONSTRAINTS(PHYSICS_DISPATCH)
+#undef PHYSICS_DISPATCH
+    solve_fixed_shape(store, begin, end, iterations, store->constraint_count);
+}
+
+int physics_store_solve(PhysicsStore* store, int begin, int end, float dt, const SolverSettings* settings) {
+    if (settings->mode == SOLVER_FIXED && !settings->approx_sqrt) {
+        physics_store_solve_constraints(store, begin, end, settings->iterations);
+        return (end - begin) / SIMD_WIDTH * settings->iterations;
+    }
+
+#define PHYSICS_DISPATCH(C) \
+    if (store->constraint_count == C) return solve_xpbd_##C(store, begin, end, dt, settings);
+    PHYSICS_KERNEL_CONSTRAINTS(PHYSICS_DISPATCH)
+#undef PHYSICS_DISPATCH
+    int n = store->constraint_count;
+    float w1[n], w2[n], inv_denominator[n];
+    simd_float lambda[n];
+    return solve_xpbd_shape(store, begin, end, dt, settings, n, w1, w2, inv_denominator, lambda);
+}
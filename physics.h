@@ -1,6 +1,8 @@
 #ifndef PHYSICS_H
 #define PHYSICS_H
 
+#include <stddef.h>
+
 typedef struct {
     float x;
     float y;
@@ -19,9 +21,100 @@ typedef struct {
     float target_length;
 } Constraint;
 
+typedef struct {
+    int p1;
+    int p2;
+    float target_length;
+} ConstraintDef;
+
+typedef enum {
+    SOLVER_FIXED, // Plain position projection, a fixed number of sweeps
+    SOLVER_XPBD   // Compliant (XPBD) projection, stops once converged
+} SolverMode;
+
+typedef struct {
+    SolverMode mode;
+    int iterations;   // Sweeps for SOLVER_FIXED, the cap for SOLVER_XPBD
+    float tolerance;  // XPBD: a creature stops once no bone is off by more (px)
+    float compliance; // XPBD: inverse stiffness; 0 is rigid, independent of dt and sweeps
+    int approx_sqrt;  // Expand the bone length around target_length instead of sqrtf
+} SolverSettings;
+
+// Ground heights sampled every cell_size pixels from `origin`, one row
+// per terrain. Lookups interpolate between the two nearest samples, and
+// beyond either end the edge sample continues flat.
+typedef struct {
+    float origin;
+    float inv_cell; // 1 / cell_size
+    int cell_count;
+    int terrain_count;
+    float* heights; // [terrain][cell], screen y of the ground
+} Heightfield;
+
+// Population-wide structure-of-arrays point store. Every creature shares
+// one skeleton, so arrays are laid out point-major ([point][creature]) and
+// SIMD lanes map to creatures. stride is creature_count padded to
+// SIMD_LANE_PAD; padding lanes are simulated but never read.
+typedef struct {
+    int creature_count;
+    int stride;
+    int point_count;
+    int constraint_count;
+
+    float* x;
+    float* y;
+    float* old_x;
+    float* old_y;
+    float* acc_x;
+    float* acc_y;
+
+    float* inv_mass; // Per point, 0 for static points
+    ConstraintDef* constraints;
+
+    // Ground under each creature: the row terrain[creature] of `ground`,
+    // or the flat ground_y passed to physics_store_integrate when NULL
+    const Heightfield* ground;
+    int* terrain; // Per creature, 0 by default
+} PhysicsStore;
+
+// Constraint counts with solver kernels specialized at compile time, so
+// the sweep over the constraint table unrolls fully; other skeletons use
+// the generic loop. Override with e.g. -D'PHYSICS_KERNEL_CONSTRAINTS(X)=X(10) X(14)'.
+#ifndef PHYSICS_KERNEL_CONSTRAINTS
+#define PHYSICS_KERNEL_CONSTRAINTS(X) X(10)
+#endif
+
+#define PHYS_INDEX(store, point, creature) ((point) * (store)->stride + (creature))
+
+// Every terrain starts flat at `height`
+Heightfield* heightfield_create(float origin, float cell_size, int cell_count, int terrain_count, float height);
+void heightfield_destroy(Heightfield* field);
+
+// Ground height under `x` on `terrain`, in constant time
+static inline float heightfield_at(const Heightfield* field, int terrain, float x) {
+    const float* row = field->heights + (size_t)terrain * field->cell_count;
+    float u = (x - field->origin) * field->inv_cell;
+    if (!(u > 0)) return row[0];
+    if (u >= field->cell_count - 1) return row[field->cell_count - 1];
+    int cell = (int)u;
+    return row[cell] + (row[cell + 1] - row[cell]) * (u - cell);
+}
+
 PointMass* create_point_mass(Vec2D position, float mass);
 void update_point_mass(PointMass* pm, float dt);
 void apply_force(PointMass* pm, Vec2D force);
 void satisfy_constraint(Constraint* c);
 
+PhysicsStore* physics_store_create(int creature_count, int point_count, const float* masses,
+                                   const ConstraintDef* constraints, int constraint_count);
+void physics_store_destroy(PhysicsStore* store);
+void physics_store_set_pose(PhysicsStore* store, int creature, const Vec2D* positions);
+void physics_store_swap(PhysicsStore* store, int a, int b);
+// Kernels over creatures [begin, end); both bounds must be multiples of SIMD_LANE_PAD.
+// Integration clamps points to the store's ground, or to ground_y without one.
+void physics_store_integrate(PhysicsStore* store, int begin, int end, float dt, float gravity, float ground_y);
+void physics_store_solve_constraints(PhysicsStore* store, int begin, int end, int iterations);
+// Returns the number of sweeps run, summed over SIMD blocks
+int physics_store_solve(PhysicsStore* store, int begin, int end, float dt, const SolverSettings* settings);
+
 #endif // PHYSICS_H
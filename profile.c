@@ -0,0 +1,151 @@
+#ifdef WALK_PROFILE
+#include "profile.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PROFILE_MAX_THREADS 256
+
+typedef struct {
+    double start; // Seconds since profile_open
+    float duration;
+    int phase;
+} ProfileEvent;
+
+// Written only by its own thread; read while every thread is idle
+typedef struct {
+    int id;
+    ProfileEvent* events;
+    int event_count;
+    int event_capacity;
+    double seconds[PROF_PHASE_COUNT];
+    long long calls[PROF_PHASE_COUNT];
+    long long items[PROF_PHASE_COUNT];
+} ProfileThread;
+
+static const char* phase_names[PROF_PHASE_COUNT] = {
+    "cache_lookup", "sense", "nn", "forces", "integrate", "constraints",
+    "retire", "fitness", "select", "breed", "reset", "record", "novelty",
+};
+
+static ProfileThread* threads[PROFILE_MAX_THREADS];
+static atomic_int thread_count;
+static _Thread_local ProfileThread* local_thread;
+
+static FILE* trace_file = NULL;
+static FILE* csv_file = NULL;
+static int trace_first = 1;
+static double epoch = 0;
+
+static ProfileThread* register_thread(void) {
+    int id = atomic_fetch_add(&thread_count, 1);
+    if (id >= PROFILE_MAX_THREADS) return NULL;
+    ProfileThread* t = (ProfileThread*)calloc(1, sizeof(ProfileThread));
+    t->id = id;
+    threads[id] = t;
+    local_thread = t;
+    return t;
+}
+
+int profile_open(const char* trace_path, const char* csv_path) {
+    epoch = timer_now();
+    if (trace_path != NULL) {
+        trace_file = fopen(trace_path, "w");
+        if (trace_file == NULL) {
+            printf("Could not open %s for writing\n", trace_path);
+            return 0;
+        }
+        fprintf(trace_file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        trace_first = 1;
+    }
+    if (csv_path != NULL) {
+        csv_file = fopen(csv_path, "w");
+        if (csv_file == NULL) {
+            printf("Could not open %s for writing\n", csv_path);
+            return 0;
+        }
+        fprintf(csv_file, "generation,phase,total_ms,max_thread_ms,calls,items\n");
+    }
+    return 1;
+}
+
+void profile_record(ProfilePhase phase, double start, long long items) {
+    double end = timer_now();
+    ProfileThread* t = local_thread;
+    if (t == NULL && (t = register_thread()) == NULL) return;
+
+    t->seconds[phase] += end - start;
+    t->calls[phase]++;
+    t->items[phase] += items;
+
+    if (trace_file == NULL) return;
+    if (t->event_count == t->event_capacity) {
+        t->event_capacity = t->event_capacity > 0 ? t->event_capacity * 2 : 4096;
+        t->events = (ProfileEvent*)realloc(t->events, t->event_capacity * sizeof(ProfileEvent));
+    }
+    t->events[t->event_count++] = (ProfileEvent){start - epoch, (float)(end - start), phase};
+}
+
+static void trace_separator(void) {
+    if (!trace_first) fprintf(trace_file, ",\n");
+    trace_first = 0;
+}
+
+void profile_generation_end(int generation) {
+    int count = atomic_load(&thread_count);
+    if (count > PROFILE_MAX_THREADS) count = PROFILE_MAX_THREADS;
+
+    if (trace_file != NULL) {
+        for (int i = 0; i < count; i++) {
+            ProfileThread* t = threads[i];
+            for (int e = 0; e < t->event_count; e++) {
+                ProfileEvent* ev = &t->events[e];
+                trace_separator();
+                fprintf(trace_file, "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                        phase_names[ev->phase], t->id, ev->start * 1e6, ev->duration * 1e6);
+            }
+            t->event_count = 0;
+        }
+        trace_separator();
+        fprintf(trace_file, "{\"name\": \"generation %d\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, \"tid\": 0, \"ts\": %.3f}",
+                generation, (timer_now() - epoch) * 1e6);
+    }
+
+    for (int p = 0; p < PROF_PHASE_COUNT; p++) {
+        double total = 0, max_thread = 0;
+        long long calls = 0, items = 0;
+        for (int i = 0; i < count; i++) {
+            ProfileThread* t = threads[i];
+            total += t->seconds[p];
+            if (t->seconds[p] > max_thread) max_thread = t->seconds[p];
+            calls += t->calls[p];
+            items += t->items[p];
+            t->seconds[p] = 0;
+            t->calls[p] = 0;
+            t->items[p] = 0;
+        }
+        if (csv_file != NULL && calls > 0) {
+            fprintf(csv_file, "%d,%s,%.4f,%.4f,%lld,%lld\n",
+                    generation, phase_names[p], total * 1000.0, max_thread * 1000.0, calls, items);
+        }
+    }
+}
+
+void profile_close(void) {
+    if (trace_file != NULL) {
+        int count = atomic_load(&thread_count);
+        if (count > PROFILE_MAX_THREADS) count = PROFILE_MAX_THREADS;
+        for (int i = 0; i < count; i++) {
+            trace_separator();
+            fprintf(trace_file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"thread %d\"}}", i, i);
+        }
+        fprintf(trace_file, "\n]}\n");
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+    if (csv_file != NULL) {
+        fclose(csv_file);
+        csv_file = NULL;
+    }
+}
+#endif // WALK_PROFILE
@@ -0,0 +1,45 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Scoped per-phase timers and item counters for the hot paths, kept per
+// thread. They exist only in builds with WALK_PROFILE defined (make
+// PROFILE=1); otherwise every macro expands to nothing.
+typedef enum {
+    PROF_CACHE_LOOKUP,
+    PROF_SENSE,
+    PROF_NN,
+    PROF_FORCES, // Muscle forces and fitness accounting
+    PROF_INTEGRATE,
+    PROF_CONSTRAINTS,
+    PROF_RETIRE,
+    PROF_FITNESS,
+    PROF_SELECT,
+    PROF_BREED,
+    PROF_RESET,
+    PROF_RECORD, // Encoding and writing trajectories
+    PROF_NOVELTY, // k-NN novelty queries
+    PROF_PHASE_COUNT
+} ProfilePhase;
+
+#ifdef WALK_PROFILE
+#include "timer.h"
+
+// Either path may be NULL. The trace is Chrome trace_event JSON; the CSV
+// has one row per phase and generation.
+int profile_open(const char* trace_path, const char* csv_path);
+void profile_close(void);
+void profile_record(ProfilePhase phase, double start, long long items);
+// Writes out every thread's records. Only call while no other thread is
+// recording, e.g. between pool_run calls.
+void profile_generation_end(int generation);
+
+#define PROFILE_BEGIN(phase) double profile_start_##phase = timer_now()
+#define PROFILE_END(phase, items) profile_record(phase, profile_start_##phase, (items))
+#define PROFILE_GENERATION_END(generation) profile_generation_end(generation)
+#else
+#define PROFILE_BEGIN(phase)
+#define PROFILE_END(phase, items)
+#define PROFILE_GENERATION_END(generation)
+#endif
+
+#endif // PROFILE_H
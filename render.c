@@ -0,0 +1,176 @@
+#include "render.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HEAD_RADIUS 8
+#define HEAD_TEXTURE_SIZE (2 * HEAD_RADIUS + 2)
+#define BONE_HALF_WIDTH 0.75f
+
+static const SDL_Color active_color = {255, 255, 255, 255};
+static const SDL_Color inactive_color = {110, 110, 110, 255}; // Retired or cached creatures
+
+// White disc with an antialiased edge. Vertex colors tint it per creature.
+static SDL_Texture* create_head_texture(SDL_Renderer* renderer) {
+    Uint32 pixels[HEAD_TEXTURE_SIZE * HEAD_TEXTURE_SIZE];
+    float center = HEAD_TEXTURE_SIZE / 2.0f;
+    for (int y = 0; y < HEAD_TEXTURE_SIZE; y++) {
+        for (int x = 0; x < HEAD_TEXTURE_SIZE; x++) {
+            float dx = x + 0.5f - center, dy = y + 0.5f - center;
+            float coverage = HEAD_RADIUS + 0.5f - sqrtf(dx * dx + dy * dy);
+            if (coverage < 0) coverage = 0;
+            if (coverage > 1) coverage = 1;
+            Uint8 alpha = (Uint8)(coverage * 255.0f);
+            // SDL_PIXELFORMAT_RGBA32 is byte order R, G, B, A on every platform
+            Uint8* p = (Uint8*)&pixels[y * HEAD_TEXTURE_SIZE + x];
+            p[0] = p[1] = p[2] = 255;
+            p[3] = alpha;
+        }
+    }
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC,
+                                             HEAD_TEXTURE_SIZE, HEAD_TEXTURE_SIZE);
+    if (texture == NULL) return NULL;
+    SDL_UpdateTexture(texture, NULL, pixels, HEAD_TEXTURE_SIZE * sizeof(Uint32));
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    return texture;
+}
+
+Renderer* render_create(SDL_Renderer* renderer) {
+    SDL_Texture* head_texture = create_head_texture(renderer);
+    if (head_texture == NULL) {
+        printf("Head texture could not be created! SDL Error: %s\n", SDL_GetError());
+        return NULL;
+    }
+    Renderer* r = (Renderer*)calloc(1, sizeof(Renderer));
+    r->renderer = renderer;
+    r->head_texture = head_texture;
+    return r;
+}
+
+void render_destroy(Renderer* r) {
+    SDL_DestroyTexture(r->head_texture);
+    free(r->bone_vertices);
+    free(r->head_vertices);
+    free(r->indices);
+    free(r->ranks);
+    free(r);
+}
+
+static void reserve_quads(Renderer* r, int quads) {
+    if (quads <= r->quad_capacity) return;
+    r->bone_vertices = (SDL_Vertex*)realloc(r->bone_vertices, (size_t)quads * 4 * sizeof(SDL_Vertex));
+    r->head_vertices = (SDL_Vertex*)realloc(r->head_vertices, (size_t)quads * 4 * sizeof(SDL_Vertex));
+    r->indices = (int*)realloc(r->indices, (size_t)quads * 6 * sizeof(int));
+    for (int q = r->quad_capacity; q < quads; q++) {
+        int* idx = &r->indices[q * 6];
+        idx[0] = q * 4;
+        idx[1] = q * 4 + 1;
+        idx[2] = q * 4 + 2;
+        idx[3] = q * 4 + 2;
+        idx[4] = q * 4 + 1;
+        idx[5] = q * 4 + 3;
+    }
+    r->quad_capacity = quads;
+}
+
+static void set_vertex(SDL_Vertex* v, float x, float y, SDL_Color color, float u, float tv) {
+    v->position.x = x;
+    v->position.y = y;
+    v->color = color;
+    v->tex_coord.x = u;
+    v->tex_coord.y = tv;
+}
+
+// Segment p1-p2 as a thin quad
+static void bone_quad(SDL_Vertex* v, float x1, float y1, float x2, float y2, SDL_Color color) {
+    float dx = x2 - x1, dy = y2 - y1;
+    float length = sqrtf(dx * dx + dy * dy);
+    float nx = BONE_HALF_WIDTH, ny = 0;
+    if (length > 0) {
+        nx = -dy / length * BONE_HALF_WIDTH;
+        ny = dx / length * BONE_HALF_WIDTH;
+    }
+    set_vertex(&v[0], x1 + nx, y1 + ny, color, 0, 0);
+    set_vertex(&v[1], x1 - nx, y1 - ny, color, 0, 0);
+    set_vertex(&v[2], x2 + nx, y2 + ny, color, 0, 0);
+    set_vertex(&v[3], x2 - nx, y2 - ny, color, 0, 0);
+}
+
+static void head_quad(SDL_Vertex* v, float x, float y, SDL_Color color) {
+    float h = HEAD_TEXTURE_SIZE / 2.0f;
+    set_vertex(&v[0], x - h, y - h, color, 0, 0);
+    set_vertex(&v[1], x - h, y + h, color, 0, 1);
+    set_vertex(&v[2], x + h, y - h, color, 1, 0);
+    set_vertex(&v[3], x + h, y + h, color, 1, 1);
+}
+
+// Slots to draw: all of them, or the top_k with the furthest pelvis
+static int visible_slots(Renderer* r, const Snapshot* snapshot) {
+    int stride = snapshot->creature_count;
+    int count = snapshot->slot_count;
+    if (r->rank_capacity < count) {
+        r->ranks = (CreatureRank*)realloc(r->ranks, count * sizeof(CreatureRank));
+        r->rank_capacity = count;
+    }
+    for (int slot = 0; slot < count; slot++) {
+        r->ranks[slot].fitness = snapshot->x[BIPED_PELVIS * stride + slot];
+        r->ranks[slot].index = slot;
+    }
+    if (r->top_k > 0 && r->top_k < count) {
+        ga_select_top(r->ranks, count, r->top_k);
+        count = r->top_k;
+    }
+    return count;
+}
+
+void render_snapshot(Renderer* r, const Snapshot* snapshot, float alpha) {
+    const float* x = snapshot->x;
+    const float* y = snapshot->y;
+    const float* old_x = snapshot->old_x;
+    const float* old_y = snapshot->old_y;
+    float beta = 1.0f - alpha;
+    int stride = snapshot->creature_count;
+    int visible = visible_slots(r, snapshot);
+    int bone_count = visible * snapshot->constraint_count;
+    reserve_quads(r, bone_count > visible ? bone_count : visible);
+
+    SDL_Vertex* bone = r->bone_vertices;
+    SDL_Vertex* head = r->head_vertices;
+    for (int i = 0; i < visible; i++) {
+        int slot = r->ranks[i].index;
+        SDL_Color color = slot < snapshot->active_count ? active_color : inactive_color;
+        // Render skeleton
+        for (int j = 0; j < snapshot->constraint_count; j++) {
+            int p1 = snapshot->constraints[j].p1 * stride + slot;
+            int p2 = snapshot->constraints[j].p2 * stride + slot;
+            bone_quad(bone, old_x[p1] * beta + x[p1] * alpha, old_y[p1] * beta + y[p1] * alpha,
+                      old_x[p2] * beta + x[p2] * alpha, old_y[p2] * beta + y[p2] * alpha, color);
+            bone += 4;
+        }
+        // Render head
+        int h = BIPED_HEAD * stride + slot;
+        head_quad(head, old_x[h] * beta + x[h] * alpha, old_y[h] * beta + y[h] * alpha, color);
+        head += 4;
+    }
+
+    SDL_RenderGeometry(r->renderer, NULL, r->bone_vertices, bone_count * 4, r->indices, bone_count * 6);
+    SDL_RenderGeometry(r->renderer, r->head_texture, r->head_vertices, visible * 4, r->indices, visible * 6);
+
+    SDL_SetRenderDrawColor(r->renderer, 150, 150, 150, 255);
+    const Heightfield* ground = snapshot->ground;
+    if (ground == NULL) {
+        SDL_RenderDrawLine(r->renderer, 0, GROUND_Y, SCREEN_WIDTH, GROUND_Y);
+        return;
+    }
+    // Every scenario's ground, as the physics sees it
+    int count = SCREEN_WIDTH / GROUND_STEP + 1;
+    for (int t = 0; t < ground->terrain_count; t++) {
+        for (int i = 0; i < count; i++) {
+            float px = (float)(i * GROUND_STEP);
+            r->ground_points[i].x = px;
+            r->ground_points[i].y = heightfield_at(ground, t, px);
+        }
+        SDL_RenderDrawLinesF(r->renderer, r->ground_points, count);
+    }
+}
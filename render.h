@@ -0,0 +1,36 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <SDL.h>
+#include "snapshot.h"
+
+#define GROUND_STEP 4 // px between the points drawn of a terrain row
+
+// Per-window drawing state. Every frame is built into two vertex batches,
+// skeleton segments and textured head quads, and drawn with one
+// SDL_RenderGeometry call each, however many creatures are visible.
+typedef struct {
+    SDL_Renderer* renderer;
+    SDL_Texture* head_texture;
+
+    SDL_Vertex* bone_vertices;
+    SDL_Vertex* head_vertices;
+    int* indices; // Shared quad index pattern
+    int quad_capacity;
+
+    CreatureRank* ranks; // Scratch for level of detail
+    int rank_capacity;
+
+    SDL_FPoint ground_points[SCREEN_WIDTH / GROUND_STEP + 1]; // One terrain row as a polyline
+
+    int top_k; // Draw only the K creatures furthest ahead; 0 draws all
+} Renderer;
+
+// Returns NULL if the head texture cannot be created. Needs SDL 2.0.18+.
+Renderer* render_create(SDL_Renderer* renderer);
+void render_destroy(Renderer* r);
+// Draws positions interpolated from the step before the snapshot (alpha
+// 0) to the snapshot itself (alpha 1)
+void render_snapshot(Renderer* r, const Snapshot* snapshot, float alpha);
+
+#endif // RENDER_H
@@ -0,0 +1,45 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// PCG32 generator. Each (seed, stream) pair is an independent sequence,
+// so work items can own their own stream and draw the same numbers no
+// matter which thread runs them.
+typedef struct {
+    uint64_t state;
+    uint64_t inc;
+} Rng;
+
+static inline uint32_t rng_next(Rng* rng) {
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ULL + rng->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+static inline void rng_seed(Rng* rng, uint64_t seed, uint64_t stream) {
+    rng->state = 0;
+    rng->inc = (stream << 1u) | 1u;
+    rng_next(rng);
+    rng->state += seed;
+    rng_next(rng);
+}
+
+// Uniform float in [0, 1)
+static inline float rng_float(Rng* rng) {
+    return (rng_next(rng) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Uniform float in [-1, 1)
+static inline float rng_symmetric(Rng* rng) {
+    return rng_float(rng) * 2.0f - 1.0f;
+}
+
+// Uniform integer in [0, n)
+static inline int rng_int(Rng* rng, int n) {
+    return (int)(((uint64_t)rng_next(rng) * (uint32_t)n) >> 32);
+}
+
+#endif // RNG_H
@@ -0,0 +1,202 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "genome.h"
+
+// Thin wrapper over AVX / SSE / scalar floats so population kernels are
+// written once. SIMD_WIDTH is the number of float lanes per register;
+// the widest instruction set enabled at compile time is used.
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+// Four halves in the high 16 bits of 32-bit lanes, widened like
+// genome_f16_decode(). The arithmetic shift moves exponent and mantissa
+// into place and keeps the sign bit; the mask clears the copies of it,
+// and the 2^112 rescale preserves it.
+static inline __m128 simd_half4_to_ps(__m128i h) {
+    __m128i bits = _mm_and_si128(_mm_srai_epi32(h, 3), _mm_set1_epi32((int)0x8FFFE000u));
+    return _mm_mul_ps(_mm_castsi128_ps(bits), _mm_set1_ps(0x1p112f));
+}
+// Four bytes, each repeated across its 32-bit lane, sign-extended
+static inline __m128 simd_byte4_to_ps(__m128i b) {
+    return _mm_cvtepi32_ps(_mm_srai_epi32(b, 24));
+}
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_WIDTH 8
+typedef __m256 simd_float;
+static inline simd_float simd_load(const float* p) { return _mm256_loadu_ps(p); }
+static inline void simd_store(float* p, simd_float v) { _mm256_storeu_ps(p, v); }
+static inline simd_float simd_set1(float f) { return _mm256_set1_ps(f); }
+static inline simd_float simd_add(simd_float a, simd_float b) { return _mm256_add_ps(a, b); }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return _mm256_sub_ps(a, b); }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return _mm256_mul_ps(a, b); }
+static inline simd_float simd_div(simd_float a, simd_float b) { return _mm256_div_ps(a, b); }
+static inline simd_float simd_sqrt(simd_float a) { return _mm256_sqrt_ps(a); }
+static inline simd_float simd_min(simd_float a, simd_float b) { return _mm256_min_ps(a, b); }
+static inline simd_float simd_max(simd_float a, simd_float b) { return _mm256_max_ps(a, b); }
+// Lanes of a that equal zero are replaced by the matching lane of b
+static inline simd_float simd_replace_zero(simd_float a, simd_float b) {
+    return _mm256_blendv_ps(a, b, _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_EQ_OQ));
+}
+// 1.0f in lanes where a < b, 0.0f elsewhere
+static inline simd_float simd_less(simd_float a, simd_float b) {
+    return _mm256_and_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ), _mm256_set1_ps(1.0f));
+}
+// Nonzero if any lane is nonzero
+static inline int simd_any(simd_float a) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_NEQ_UQ)) != 0;
+}
+// SIMD_WIDTH halves, widened exactly to float
+static inline simd_float simd_load_f16(const uint16_t* p) {
+#if defined(__F16C__)
+    return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)p));
+#else
+    __m128i h = _mm_loadu_si128((const __m128i*)p);
+    __m128 lo = simd_half4_to_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), h));
+    __m128 hi = simd_half4_to_ps(_mm_unpackhi_epi16(_mm_setzero_si128(), h));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+#endif
+}
+// SIMD_WIDTH signed bytes, as floats
+static inline simd_float simd_load_i8(const int8_t* p) {
+    __m128i b = _mm_loadl_epi64((const __m128i*)p);
+#if defined(__AVX2__)
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(b));
+#else
+    b = _mm_unpacklo_epi8(b, b);
+    __m128 lo = simd_byte4_to_ps(_mm_unpacklo_epi16(b, b));
+    __m128 hi = simd_byte4_to_ps(_mm_unpackhi_epi16(b, b));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+#endif
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_WIDTH 4
+typedef __m128 simd_float;
+static inline simd_float simd_load(const float* p) { return _mm_loadu_ps(p); }
+static inline void simd_store(float* p, simd_float v) { _mm_storeu_ps(p, v); }
+static inline simd_float simd_set1(float f) { return _mm_set1_ps(f); }
+static inline simd_float simd_add(simd_float a, simd_float b) { return _mm_add_ps(a, b); }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return _mm_sub_ps(a, b); }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return _mm_mul_ps(a, b); }
+static inline simd_float simd_div(simd_float a, simd_float b) { return _mm_div_ps(a, b); }
+static inline simd_float simd_sqrt(simd_float a) { return _mm_sqrt_ps(a); }
+static inline simd_float simd_min(simd_float a, simd_float b) { return _mm_min_ps(a, b); }
+static inline simd_float simd_max(simd_float a, simd_float b) { return _mm_max_ps(a, b); }
+static inline simd_float simd_replace_zero(simd_float a, simd_float b) {
+    __m128 mask = _mm_cmpeq_ps(a, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+static inline simd_float simd_less(simd_float a, simd_float b) {
+    return _mm_and_ps(_mm_cmplt_ps(a, b), _mm_set1_ps(1.0f));
+}
+static inline int simd_any(simd_float a) {
+    return _mm_movemask_ps(_mm_cmpneq_ps(a, _mm_setzero_ps())) != 0;
+}
+static inline simd_float simd_load_f16(const uint16_t* p) {
+    __m128i h = _mm_loadl_epi64((const __m128i*)p);
+    return simd_half4_to_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), h));
+}
+static inline simd_float simd_load_i8(const int8_t* p) {
+    int32_t bytes;
+    memcpy(&bytes, p, sizeof(bytes));
+    __m128i b = _mm_cvtsi32_si128(bytes);
+    b = _mm_unpacklo_epi8(b, b);
+    return simd_byte4_to_ps(_mm_unpacklo_epi16(b, b));
+}
+#else
+#include <math.h>
+#define SIMD_WIDTH 1
+typedef float simd_float;
+static inline simd_float simd_load(const float* p) { return *p; }
+static inline void simd_store(float* p, simd_float v) { *p = v; }
+static inline simd_float simd_set1(float f) { return f; }
+static inline simd_float simd_add(simd_float a, simd_float b) { return a + b; }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return a - b; }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return a * b; }
+static inline simd_float simd_div(simd_float a, simd_float b) { return a / b; }
+static inline simd_float simd_sqrt(simd_float a) { return sqrtf(a); }
+static inline simd_float simd_min(simd_float a, simd_float b) { return b < a ? b : a; }
+static inline simd_float simd_max(simd_float a, simd_float b) { return b > a ? b : a; }
+static inline simd_float simd_replace_zero(simd_float a, simd_float b) { return a == 0.0f ? b : a; }
+static inline simd_float simd_less(simd_float a, simd_float b) { return a < b ? 1.0f : 0.0f; }
+static inline int simd_any(simd_float a) { return a != 0.0f; }
+static inline simd_float simd_load_f16(const uint16_t* p) { return genome_f16_decode(*p); }
+static inline simd_float simd_load_i8(const int8_t* p) { return (float)*p; }
+#endif
+
+
+// Kernel bodies are written once with their shape as ordinary arguments
+// and forced inline into wrappers that pass constants, so loop bounds are
+// known and SIMD_UNROLL can flatten them completely.
+#if defined(__GNUC__)
+#define SIMD_FORCE_INLINE static inline __attribute__((always_inline))
+#define SIMD_UNROLL _Pragma("GCC unroll 16")
+#else
+#define SIMD_FORCE_INLINE static inline
+#define SIMD_UNROLL
+#endif
+
+static inline simd_float simd_madd(simd_float a, simd_float b, simd_float c) {
+    return simd_add(simd_mul(a, b), c);
+}
+
+// Rational tanh approximation (the 13/6 fit used by Eigen), clamped where
+// tanh rounds to +-1 in float. Max absolute error vs tanhf is below 1e-6.
+static inline simd_float simd_tanh(simd_float x) {
+    const float limit = 7.90531110763549805f;
+    x = simd_min(simd_max(x, simd_set1(-limit)), simd_set1(limit));
+    simd_float x2 = simd_mul(x, x);
+
+    simd_float p = simd_set1(-2.76076847742355e-16f);
+    p = simd_madd(p, x2, simd_set1(2.00018790482477e-13f));
+    p = simd_madd(p, x2, simd_set1(-8.60467152213735e-11f));
+    p = simd_madd(p, x2, simd_set1(5.12229709037114e-08f));
+    p = simd_madd(p, x2, simd_set1(1.48572235717979e-05f));
+    p = simd_madd(p, x2, simd_set1(6.37261928875436e-04f));
+    p = simd_madd(p, x2, simd_set1(4.89352455891786e-03f));
+    p = simd_mul(p, x);
+
+    simd_float q = simd_set1(1.19825839466702e-06f);
+    q = simd_madd(q, x2, simd_set1(1.18534705686654e-04f));
+    q = simd_madd(q, x2, simd_set1(2.26843463243900e-03f));
+    q = simd_madd(q, x2, simd_set1(4.89352518554385e-03f));
+    return simd_div(p, q);
+}
+
+// Population arrays are padded to a multiple of this many creatures so
+// every creature runs through full-width vector code on any target.
+#define SIMD_LANE_PAD 8
+#define SIMD_ALIGNMENT 64
+
+static inline int simd_pad(int count) {
+    return (count + SIMD_LANE_PAD - 1) / SIMD_LANE_PAD * SIMD_LANE_PAD;
+}
+
+// Cache-line aligned, zero-initialized allocation
+static inline void* simd_alloc(size_t size) {
+    size = (size + SIMD_ALIGNMENT - 1) / SIMD_ALIGNMENT * SIMD_ALIGNMENT;
+#ifdef _WIN32
+    void* p = _aligned_malloc(size, SIMD_ALIGNMENT);
+#else
+    void* p = NULL;
+    if (posix_memalign(&p, SIMD_ALIGNMENT, size) != 0) p = NULL;
+#endif
+    if (p != NULL) memset(p, 0, size);
+    return p;
+}
+
+static inline void simd_free(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+#endif // SIMD_H
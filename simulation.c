@@ -1,230 +1,1102 @@
 #include "simulation.h"
+#include "simd.h"
+#include "profile.h"
+#include "timer.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <limits.h>
+#include <stdatomic.h>
 
-#define POPULATION_SIZE 50
 #define NN_INPUTS 8
-#define NN_HIDDEN 16
 #define NN_OUTPUTS 4
-#define GENE_COUNT (NN_INPUTS * NN_HIDDEN + NN_HIDDEN * NN_OUTPUTS)
-#define MUTATION_RATE 0.05f
 
-#define SIM_DURATION 10.0f // seconds
-#define GROUND_Y (SCREEN_HEIGHT - 100)
+#define BIPED_POINT_MASS 1.0f
+#define GRAVITY_FORCE 50.0f
+#define CONSTRAINT_ITERATIONS 5
+#define SOLVER_TOLERANCE 0.5f // px
+#define SIM_CHUNK 32 // Creatures per parallel task, a multiple of SIMD_LANE_PAD
+#define SPAWN_CHUNK 64 // Steady-state children bred per parallel task
 
-static Biped create_biped(int creature_index, Vec2D start_pos);
-static void destroy_biped(Biped* b);
-static void reset_biped(Biped* b, Vec2D start_pos);
+#define START_X 200.0f
+#define START_Y (GROUND_Y - 100.0f)
 
-SimulationState* simulation_create() {
+#define SCENARIO_SEED 0x5CE7A210D5EEDULL // Scenarios are the same for every run seed
+#define TERRAIN_CELL 8.0f     // px between heightfield samples
+#define TERRAIN_LENGTH 16384  // px of terrain past the start; flat beyond
+#define TERRAIN_FLAT 100.0f   // px of flat ground past the furthest start
+#define TERRAIN_RAMP 200.0f   // px over which the terrain grows to full height
+#define TERRAIN_WAVES 3
+#define TWO_PI 6.2831853f
+
+#define NOVELTY_DISTANCE_SCALE 5000.0f // px walked per unit of the behavior descriptor
+
+#define UPRIGHT_WEIGHT 5.0f
+#define AIR_TIME_PENALTY 20.0f
+#define SPINE_LENGTH 30.0f
+
+// Keep the default controller and the skeleton on the compile-time
+// specialized kernels
+#define MATCHES_CONTROLLER(I, H, O) || ((I) == NN_INPUTS && (H) == DEFAULT_NN_HIDDEN && (O) == NN_OUTPUTS)
+#define MATCHES_SKELETON(C) || ((C) == NUM_CONSTRAINTS)
+_Static_assert(0 NN_KERNEL_SHAPES(MATCHES_CONTROLLER), "NN_KERNEL_SHAPES lacks the controller shape");
+_Static_assert(0 PHYSICS_KERNEL_CONSTRAINTS(MATCHES_SKELETON), "PHYSICS_KERNEL_CONSTRAINTS lacks NUM_CONSTRAINTS");
+
+// Start pose, relative to the biped's start position
+static const Vec2D biped_pose[NUM_POINTS] = {
+    {0, -30},   // Head
+    {0, 0},     // Chest
+    {0, 30},    // Pelvis
+    {-15, 60},  // L Knee
+    {-15, 90},  // L Ankle
+    {15, 60},   // R Knee
+    {15, 90},   // R Ankle
+    {-20, 30},  // L Elbow
+    {-20, 60},  // L Hand
+    {20, 30},   // R Elbow
+    {20, 60},   // R Hand
+};
+
+// Skeleton topology, shared by every biped
+static const ConstraintDef biped_constraints[NUM_CONSTRAINTS] = {
+    {0, 1, 30},  // Neck
+    {1, 2, 30},  // Spine
+    {1, 7, 30},  // L Upper Arm
+    {7, 8, 30},  // L Forearm
+    {1, 9, 30},  // R Upper Arm
+    {9, 10, 30}, // R Forearm
+    {2, 3, 30},  // L Thigh
+    {3, 4, 30},  // L Shin
+    {2, 5, 30},  // R Thigh
+    {5, 6, 30},  // R Shin
+};
+
+static void reset_biped(SimulationState* state, int index, Vec2D start_pos);
+
+// Instances in the current chunk
+static int chunk_instances(const SimulationState* state) {
+    return state->chunk_count * state->scenario_count;
+}
+
+// Lays out the slots for a new chunk: instances that still need
+// simulating first, cached ones after them. The instances of a creature
+// stay next to each other, so its genome is read once and then copied
+// from cache into their slots. Loads every instance's controller into its
+// slot and resets its pose.
+static void assign_slots(SimulationState* state) {
+    int count = chunk_instances(state);
+    int active = 0;
+    for (int i = 0; i < count; i++) {
+        if (!state->bipeds[i].cached) state->slot_creature[active++] = i;
+    }
+    state->active_count = active;
+    for (int i = 0; i < count; i++) {
+        if (state->bipeds[i].cached) state->slot_creature[active++] = i;
+    }
+
+    for (int slot = 0; slot < count; slot++) {
+        int instance = state->slot_creature[slot];
+        Biped* b = &state->bipeds[instance];
+        b->slot = slot;
+        nn_batch_load_genome(state->controllers, slot, ga_genome(state->population, b->creature_index));
+        const Scenario* scenario = &state->scenarios[b->scenario];
+        reset_biped(state, instance, (Vec2D){START_X + scenario->start_offset, START_Y});
+    }
+    state->steps_since_check = 0;
+}
+
+// Slots needed to simulate `config` one chunk at a time
+static int chunk_capacity(const SimConfig* config) {
+    int chunk = config->chunk_size;
+    return chunk > 0 && chunk < config->population_size ? chunk : config->population_size;
+}
+
+int simulation_gene_count(const SimConfig* config) {
+    return NN_INPUTS * config->hidden_count + config->hidden_count * NN_OUTPUTS;
+}
+
+void simulation_estimate_memory(const SimConfig* config, int use_cache, MemoryEstimate* estimate) {
+    int gene_count = simulation_gene_count(config);
+    size_t element = genome_element_size(config->genome_format);
+    // Two genome arenas (current and next generation) and GA bookkeeping
+    estimate->per_creature = 2 * (size_t)ga_gene_stride(gene_count, config->genome_format) * element +
+                             sizeof(Creature) + sizeof(CreatureRank);
+    // Point state, the batched controller, its I/O rows and bookkeeping,
+    // for every scenario
+    size_t per_instance = 6 * NUM_POINTS * sizeof(float) + gene_count * element +
+                          (NN_INPUTS + NN_OUTPUTS) * sizeof(float) + sizeof(Biped) + 3 * sizeof(int);
+    estimate->per_slot = per_instance * config->scenario_count;
+    estimate->cache = use_cache ? fitness_cache_bytes(4 * config->population_size) : 0;
+
+    int slots = simd_pad(chunk_capacity(config) * config->scenario_count);
+    estimate->total = estimate->per_creature * config->population_size + per_instance * slots + estimate->cache;
+}
+
+int simulation_fit_memory_budget(SimConfig* config, int use_cache, MemoryEstimate* estimate) {
+    simulation_estimate_memory(config, use_cache, estimate);
+    if (config->memory_budget_mb <= 0) return 1;
+
+    double budget = config->memory_budget_mb * 1024 * 1024;
+    if (estimate->total <= budget) return 1;
+    if (config->chunk_size > 0) return 0;
+
+    // Largest chunk, in whole SIMD blocks, that fits next to the genomes
+    double fixed = (double)estimate->per_creature * config->population_size + estimate->cache;
+    double slots = (budget - fixed) / estimate->per_slot;
+    int chunk = slots < config->population_size ? (int)slots / SIMD_LANE_PAD * SIMD_LANE_PAD : config->population_size;
+    if (chunk < SIMD_LANE_PAD) return 0;
+    config->chunk_size = chunk;
+    simulation_estimate_memory(config, use_cache, estimate);
+    return 1;
+}
+
+// Rolling ground for `terrain`: flat past the furthest start, then a sum
+// of waves that fades in over TERRAIN_RAMP and stays within `height` of
+// GROUND_Y
+static void roll_terrain(Heightfield* field, int terrain, float flat_until, float height, Rng* rng) {
+    float wavelength[TERRAIN_WAVES], phase[TERRAIN_WAVES], weight[TERRAIN_WAVES];
+    float total = 0;
+    for (int w = 0; w < TERRAIN_WAVES; w++) {
+        wavelength[w] = 150.0f + 450.0f * rng_float(rng);
+        phase[w] = TWO_PI * rng_float(rng);
+        weight[w] = 0.5f + rng_float(rng);
+        total += weight[w];
+    }
+
+    float* row = field->heights + (size_t)terrain * field->cell_count;
+    for (int cell = 0; cell < field->cell_count; cell++) {
+        float x = field->origin + cell * TERRAIN_CELL;
+        float ramp = (x - flat_until) / TERRAIN_RAMP;
+        if (ramp <= 0) continue;
+        if (ramp > 1) ramp = 1;
+        float rise = 0;
+        for (int w = 0; w < TERRAIN_WAVES; w++) {
+            rise += weight[w] * sinf(TWO_PI * (x - flat_until) / wavelength[w] + phase[w]);
+        }
+        row[cell] = GROUND_Y - height * ramp * rise / total;
+    }
+}
+
+// Draws scenarios 1 to scenario_count - 1 within the config's limits.
+// Each scenario with terrain gets its own heightfield row; scenario 0
+// keeps the flat row 0.
+static void create_scenarios(SimulationState* state) {
+    const SimConfig* config = &state->config;
+    int count = state->scenario_count;
+    int rolling = config->terrain_height > 0 && count > 1;
+    state->scenarios = (Scenario*)calloc(count, sizeof(Scenario));
+    state->terrain = NULL;
+    if (rolling) {
+        float origin = START_X - config->start_offset - TERRAIN_FLAT;
+        int cells = (int)((TERRAIN_LENGTH + config->start_offset + 2 * TERRAIN_FLAT) / TERRAIN_CELL) + 1;
+        state->terrain = heightfield_create(origin, TERRAIN_CELL, cells, count, GROUND_Y);
+    }
+
+    Rng rng;
+    for (int s = 1; s < count; s++) {
+        rng_seed(&rng, SCENARIO_SEED, (uint64_t)s);
+        Scenario* scenario = &state->scenarios[s];
+        scenario->start_offset = config->start_offset * rng_symmetric(&rng);
+        if (config->push_speed > 0) {
+            scenario->push_time = config->sim_duration * (0.25f + 0.5f * rng_float(&rng));
+            scenario->push_speed = config->push_speed * (0.5f + 0.5f * rng_float(&rng));
+            if (rng_float(&rng) < 0.5f) scenario->push_speed = -scenario->push_speed;
+        }
+        if (rolling) {
+            scenario->terrain = s;
+            roll_terrain(state->terrain, s, START_X + config->start_offset + TERRAIN_FLAT, config->terrain_height,
+                         &rng);
+        }
+    }
+}
+
+SimulationState* simulation_create(const SimConfig* config, uint64_t seed, int thread_count) {
     SimulationState* state = (SimulationState*)malloc(sizeof(SimulationState));
-    state->population = ga_create_population(POPULATION_SIZE, NN_INPUTS, NN_HIDDEN, NN_OUTPUTS, MUTATION_RATE);
-    state->bipeds = (Biped*)malloc(POPULATION_SIZE * sizeof(Biped));
+    state->config = *config;
+    state->population = ga_create_population(config->population_size, NN_INPUTS, config->hidden_count, NN_OUTPUTS,
+                                             config->mutation_rate, config->elite_fraction, config->genome_format, seed);
+    state->population->mutation_noise = config->mutation_noise;
+    OptimizerSettings optimizer = {OPTIMIZER_GA, 0, 0};
+    state->optimizer = optimizer_create(state->population, &optimizer, NULL);
+    state->capacity = chunk_capacity(config);
+    state->chunk_begin = 0;
+    state->chunk_count = state->capacity;
+    state->scenario_count = config->scenario_count;
+    int slots = state->capacity * state->scenario_count;
+    state->pool = pool_create(thread_count);
+    state->controllers = nn_batch_create(slots, NN_INPUTS, config->hidden_count, NN_OUTPUTS, config->genome_format);
+    state->nn_inputs = (float*)simd_alloc(NN_INPUTS * state->controllers->stride * sizeof(float));
+    state->nn_outputs = (float*)simd_alloc(NN_OUTPUTS * state->controllers->stride * sizeof(float));
+    state->bipeds = (Biped*)malloc(slots * sizeof(Biped));
+    state->slot_creature = (int*)malloc(slots * sizeof(int));
+    state->free_slots = (int*)malloc(slots * sizeof(int));
     state->generation = 1;
     state->sim_time = 0;
+    state->verbose = 1;
+    state->best_fitness = 0;
+    state->avg_fitness = 0;
+    state->worst_fitness = 0;
+    state->fitness_cache = NULL;
+    state->recorder = NULL;
+    state->novelty = (NoveltySettings){0, 0, 0};
+    state->archive = NULL;
+    state->behaviors = NULL;
+    state->novelty_scores = NULL;
+    state->avg_novelty = 0;
+    state->novelty_seconds = 0;
+    state->early = (EarlyTermination){0, 0, 0, 0, 0.25f};
+    state->creature_steps = 0;
+    state->evolution = EVOLUTION_GENERATIONAL;
+    state->steady = 0;
+    state->steady_steps = 0;
+    state->steady_births = 0;
+    state->steady_evaluated = 0;
+    state->solver = (SolverSettings){SOLVER_FIXED, CONSTRAINT_ITERATIONS, SOLVER_TOLERANCE, 0, 0};
+    state->solver_sweeps = 0;
+    state->solver_block_steps = 0;
+    state->history = NULL;
+    state->history_count = 0;
+    state->history_capacity = 0;
 
-    for (int i = 0; i < POPULATION_SIZE; i++) {
-        state->bipeds[i] = create_biped(i, (Vec2D){200, GROUND_Y - 100});
-    }
+    float masses[NUM_POINTS];
+    for (int i = 0; i < NUM_POINTS; i++) masses[i] = BIPED_POINT_MASS;
+    state->physics = physics_store_create(slots, NUM_POINTS, masses, biped_constraints, NUM_CONSTRAINTS);
+    create_scenarios(state);
+    state->physics->ground = state->terrain;
 
+    simulation_reload(state);
     return state;
 }
 
 void simulation_destroy(SimulationState* state) {
+    if (state->fitness_cache != NULL) fitness_cache_destroy(state->fitness_cache);
+    simulation_stop_recording(state);
+    if (state->archive != NULL) novelty_archive_destroy(state->archive);
+    free(state->behaviors);
+    free(state->novelty_scores);
+    optimizer_destroy(state->optimizer);
     ga_destroy_population(state->population);
-    for (int i = 0; i < POPULATION_SIZE; i++) {
-        destroy_biped(&state->bipeds[i]);
-    }
+    physics_store_destroy(state->physics);
+    heightfield_destroy(state->terrain);
+    free(state->scenarios);
+    pool_destroy(state->pool);
+    nn_batch_destroy(state->controllers);
+    simd_free(state->nn_inputs);
+    simd_free(state->nn_outputs);
+    free(state->slot_creature);
+    free(state->free_slots);
     free(state->bipeds);
+    free(state->history);
     free(state);
 }
 
-void simulation_update(SimulationState* state, float dt) {
-    state->sim_time += dt;
+// Ground under `x` for the instance in `slot`
+static inline float ground_at(const SimulationState* state, int slot, float x) {
+    if (state->terrain == NULL) return GROUND_Y;
+    return heightfield_at(state->terrain, state->physics->terrain[slot], x);
+}
+
+// Sensing, control and physics for slots [begin, end) over one step.
+// Creatures are independent, so ranges can run on any thread in any order.
+// Returns the constraint solver sweeps taken
+static int step_range(SimulationState* state, int begin, int end, float dt) {
+    PhysicsStore* ps = state->physics;
+    float* x = ps->x;
+    float* y = ps->y;
+    int stride = state->controllers->stride;
+    int last = end < state->active_count ? end : state->active_count;
 
-    for (int i = 0; i < POPULATION_SIZE; i++) {
-        Biped* b = &state->bipeds[i];
-        
-        // --- NN Input Calculation ---
-        float inputs[NN_INPUTS];
-        PointMass* chest = b->points[1];
-        PointMass* pelvis = b->points[2];
-        PointMass* l_ankle = b->points[4];
-        PointMass* r_ankle = b->points[6];
-        PointMass* l_hand = b->points[8];
-        PointMass* r_hand = b->points[10];
+    // --- NN Input Calculation, one matrix row per input ---
+    PROFILE_BEGIN(PROF_SENSE);
+    float* inputs = state->nn_inputs;
+    for (int i = begin; i < last; i++) {
+        int chest = PHYS_INDEX(ps, BIPED_CHEST, i);
+        int pelvis = PHYS_INDEX(ps, BIPED_PELVIS, i);
+        int l_ankle = PHYS_INDEX(ps, BIPED_L_ANKLE, i);
+        int r_ankle = PHYS_INDEX(ps, BIPED_R_ANKLE, i);
+        int l_hand = PHYS_INDEX(ps, BIPED_L_HAND, i);
+        int r_hand = PHYS_INDEX(ps, BIPED_R_HAND, i);
 
         // Input 0: Pelvis height from ground
-        inputs[0] = (GROUND_Y - pelvis->position.y) / 100.f; 
+        inputs[0 * stride + i] = (ground_at(state, i, x[pelvis]) - y[pelvis]) / 100.f;
         // Input 1: Torso angle (upright = 0)
-        inputs[1] = atan2f(chest->position.x - pelvis->position.x, chest->position.y - pelvis->position.y);
+        inputs[1 * stride + i] = atan2f(x[chest] - x[pelvis], y[chest] - y[pelvis]);
         // Inputs 2,3: Foot positions relative to pelvis (y)
-        inputs[2] = (l_ankle->position.y - pelvis->position.y) / 100.f;
-        inputs[3] = (r_ankle->position.y - pelvis->position.y) / 100.f;
+        inputs[2 * stride + i] = (y[l_ankle] - y[pelvis]) / 100.f;
+        inputs[3 * stride + i] = (y[r_ankle] - y[pelvis]) / 100.f;
         // Inputs 4,5: Foot positions relative to pelvis (x)
-        inputs[4] = (l_ankle->position.x - pelvis->position.x) / 100.f;
-        inputs[5] = (r_ankle->position.x - pelvis->position.x) / 100.f;
+        inputs[4 * stride + i] = (x[l_ankle] - x[pelvis]) / 100.f;
+        inputs[5 * stride + i] = (x[r_ankle] - x[pelvis]) / 100.f;
         // Inputs 6,7: Hand positions relative to pelvis (y)
-        inputs[6] = (l_hand->position.y - pelvis->position.y) / 100.f;
-        inputs[7] = (r_hand->position.y - pelvis->position.y) / 100.f;
+        inputs[6 * stride + i] = (y[l_hand] - y[pelvis]) / 100.f;
+        inputs[7 * stride + i] = (y[r_hand] - y[pelvis]) / 100.f;
+    }
+
+    PROFILE_END(PROF_SENSE, last - begin);
+
+    // --- Run every NN in the range at once ---
+    PROFILE_BEGIN(PROF_NN);
+    float* outputs = state->nn_outputs;
+    nn_batch_run(state->controllers, begin, end, inputs, outputs);
+    PROFILE_END(PROF_NN, end - begin);
 
-        // --- Run NN ---
-        float outputs[NN_OUTPUTS];
-        nn_run(state->population->creatures[i].nn, inputs, outputs);
+    PROFILE_BEGIN(PROF_FORCES);
+    float leg_force = state->config.leg_force;
+    float arm_force = state->config.arm_force;
+    for (int i = begin; i < last; i++) {
+        Biped* b = &state->bipeds[state->slot_creature[i]];
+        int chest = PHYS_INDEX(ps, BIPED_CHEST, i);
+        int pelvis = PHYS_INDEX(ps, BIPED_PELVIS, i);
+        int l_ankle = PHYS_INDEX(ps, BIPED_L_ANKLE, i);
+        int r_ankle = PHYS_INDEX(ps, BIPED_R_ANKLE, i);
+        int l_hand = PHYS_INDEX(ps, BIPED_L_HAND, i);
+        int r_hand = PHYS_INDEX(ps, BIPED_R_HAND, i);
 
         // --- Apply Forces from NN ---
-        apply_force(l_ankle, (Vec2D){outputs[0] * 2000.f, 0});
-        apply_force(r_ankle, (Vec2D){outputs[1] * 2000.f, 0});
-        apply_force(l_hand, (Vec2D){outputs[2] * 1000.f, 0});
-        apply_force(r_hand, (Vec2D){outputs[3] * 1000.f, 0});
+        ps->acc_x[l_ankle] += outputs[0 * stride + i] * leg_force * ps->inv_mass[BIPED_L_ANKLE];
+        ps->acc_x[r_ankle] += outputs[1 * stride + i] * leg_force * ps->inv_mass[BIPED_R_ANKLE];
+        ps->acc_x[l_hand] += outputs[2 * stride + i] * arm_force * ps->inv_mass[BIPED_L_HAND];
+        ps->acc_x[r_hand] += outputs[3 * stride + i] * arm_force * ps->inv_mass[BIPED_R_HAND];
 
-        // --- Update Physics & Fitness States ---
-        float upright_bonus = fmaxf(0, chest->position.y - pelvis->position.y); // Reward for chest over pelvis
+        // --- Scenario push: one step of acceleration changes every
+        // point's velocity by push_speed ---
+        if (b->push_in > 0 && (b->push_in -= dt) <= 0) {
+            float push = state->scenarios[b->scenario].push_speed / dt;
+            for (int p = 0; p < NUM_POINTS; p++) ps->acc_x[PHYS_INDEX(ps, p, i)] += push;
+        }
+
+        // --- Update Fitness States ---
+        float upright_bonus = fmaxf(0, y[chest] - y[pelvis]); // Reward for chest over pelvis
         b->total_upright_bonus += upright_bonus * dt;
 
-        if (l_ankle->position.y < GROUND_Y - 1 && r_ankle->position.y < GROUND_Y - 1) {
+        int left_air = y[l_ankle] < ground_at(state, i, x[l_ankle]) - 1;
+        int right_air = y[r_ankle] < ground_at(state, i, x[r_ankle]) - 1;
+        if (left_air && right_air) {
             b->air_time += dt;
         }
 
-        for (int j = 0; j < NUM_POINTS; j++) {
-            apply_force(b->points[j], (Vec2D){0, 50}); // Gravity
-            update_point_mass(b->points[j], dt);
-            // Ground collision
-            if (b->points[j]->position.y > GROUND_Y) {
-                b->points[j]->position.y = GROUND_Y;
-            }
+        // --- Behavior for novelty search: lean of the spine from
+        // upright (screen y grows downwards), foot contacts ---
+        if (state->archive != NULL) {
+            b->elapsed += dt;
+            b->total_torso_angle += atan2f(x[chest] - x[pelvis], y[pelvis] - y[chest]) * dt;
+            if (!left_air) b->left_contact += dt;
+            if (!right_air) b->right_contact += dt;
         }
-        for (int j = 0; j < 5; j++) {
-            for (int k = 0; k < NUM_CONSTRAINTS; k++) {
-                satisfy_constraint(b->constraints[k]);
+    }
+
+    PROFILE_END(PROF_FORCES, last - begin);
+
+    // --- Physics over the whole range ---
+    PROFILE_BEGIN(PROF_INTEGRATE);
+    physics_store_integrate(ps, begin, end, dt, GRAVITY_FORCE, GROUND_Y);
+    PROFILE_END(PROF_INTEGRATE, (long long)(end - begin) * NUM_POINTS);
+    PROFILE_BEGIN(PROF_CONSTRAINTS);
+    int sweeps = physics_store_solve(ps, begin, end, dt, &state->solver);
+    PROFILE_END(PROF_CONSTRAINTS, (long long)sweeps * SIMD_WIDTH * NUM_CONSTRAINTS);
+    return sweeps;
+}
+
+// Points each recorded creature of the chunk that is still being
+// simulated at the slot of its first scenario for the next steps;
+// compaction only happens between them
+static void track_recorded(SimulationState* state) {
+    TrajectoryRecorder* rec = state->recorder;
+    for (int k = 0; k < rec->creature_count; k++) {
+        int i = k - state->chunk_begin;
+        int slot = -1;
+        if (!state->steady && i >= 0 && i < state->chunk_count) {
+            const Biped* b = &state->bipeds[i * state->scenario_count];
+            if (b->slot < state->active_count) slot = b->slot;
+        }
+        rec->slots[k] = slot;
+    }
+}
+
+// Captures the step just taken by recorded creatures in slots [begin, end)
+static void capture_recorded(TrajectoryRecorder* rec, const PhysicsStore* ps, int begin, int end) {
+    for (int k = 0; k < rec->creature_count; k++) {
+        int slot = rec->slots[k];
+        if (slot >= begin && slot < end) trajectory_capture(rec, k, ps, slot);
+    }
+}
+
+typedef struct {
+    SimulationState* state;
+    float dt;
+    int steps;
+    int end; // Active slots rounded up to SIMD_LANE_PAD
+    atomic_llong sweeps;
+} StepTask;
+
+static void step_task(void* ctx, int task, int thread) {
+    StepTask* t = (StepTask*)ctx;
+    int begin = task * SIM_CHUNK;
+    int end = begin + SIM_CHUNK;
+    if (end > t->end) end = t->end;
+    long long sweeps = 0;
+    TrajectoryRecorder* rec = t->state->recorder;
+    for (int s = 0; s < t->steps; s++) {
+        sweeps += step_range(t->state, begin, end, t->dt);
+        if (rec != NULL) capture_recorded(rec, t->state->physics, begin, end);
+    }
+    atomic_fetch_add(&t->sweeps, sweeps);
+}
+
+// Advances every active creature by `steps` steps, joining the pool once
+static void run_steps(SimulationState* state, float dt, int steps) {
+    StepTask task = {state, dt, steps, simd_pad(state->active_count)};
+    atomic_init(&task.sweeps, 0);
+    if (state->recorder != NULL) track_recorded(state);
+    int chunks = (task.end + SIM_CHUNK - 1) / SIM_CHUNK;
+    pool_run(state->pool, chunks, step_task, &task);
+    state->creature_steps += (long long)state->active_count * steps;
+    state->solver_sweeps += atomic_load(&task.sweeps);
+    state->solver_block_steps += (long long)task.end / SIMD_WIDTH * steps;
+}
+
+static float biped_fitness(SimulationState* state, const Biped* b) {
+    PhysicsStore* ps = state->physics;
+    float distance_moved = ps->x[PHYS_INDEX(ps, BIPED_PELVIS, b->slot)] - b->start_pos.x;
+
+    float fitness = distance_moved;
+    fitness += b->total_upright_bonus * UPRIGHT_WEIGHT; // Reward for staying upright
+    fitness -= b->air_time * AIR_TIME_PENALTY; // Penalize jumping
+    return fitness;
+}
+
+// Everything besides the genome that decides a creature's fitness
+static uint64_t simulation_params_hash(const SimulationState* state, float dt) {
+    const SolverSettings* solver = &state->solver;
+    const float params[] = {
+        dt, state->config.sim_duration, GRAVITY_FORCE, GROUND_Y,
+        START_X, START_Y, state->config.leg_force, state->config.arm_force, BIPED_POINT_MASS,
+        solver->mode, solver->iterations, solver->tolerance, solver->compliance, solver->approx_sqrt,
+    };
+    uint64_t hash = fitness_cache_hash(params, sizeof(params), 0);
+    if (state->scenario_count == 1) return hash;
+
+    // The scenarios, which follow from these, and how they are combined
+    const SimConfig* config = &state->config;
+    const float scenarios[] = {
+        state->scenario_count, config->combine, config->quantile,
+        config->terrain_height, config->start_offset, config->push_speed,
+    };
+    return fitness_cache_hash(scenarios, sizeof(scenarios), hash);
+}
+
+// Looks every genome of the chunk up in the fitness cache before its
+// first step. Cached creatures never enter the active set.
+static void begin_chunk(SimulationState* state, float dt) {
+    if (state->fitness_cache == NULL || state->archive != NULL) return;
+
+    Population* pop = state->population;
+    uint64_t params = simulation_params_hash(state, dt);
+    int any_cached = 0;
+    PROFILE_BEGIN(PROF_CACHE_LOOKUP);
+    for (int i = 0; i < state->chunk_count; i++) {
+        Biped* first = &state->bipeds[i * state->scenario_count];
+        first->genome_key = fitness_cache_hash(ga_genome(pop, first->creature_index),
+                                                (size_t)pop->gene_count * genome_element_size(pop->format), params);
+        first->cached = fitness_cache_lookup(state->fitness_cache, first->genome_key, &first->cached_fitness);
+        if (state->recorder != NULL && first->creature_index < state->recorder->creature_count) first->cached = 0;
+        // The fitness is that of all scenarios together
+        for (int s = 1; s < state->scenario_count; s++) first[s].cached = first->cached;
+        any_cached |= first->cached;
+    }
+    PROFILE_END(PROF_CACHE_LOOKUP, state->chunk_count);
+    if (any_cached) assign_slots(state);
+}
+
+static int early_termination_enabled(const SimulationState* state) {
+    return state->early.max_torso_tilt > 0 || state->early.stall_window > 0 || state->early.max_speed > 0;
+}
+
+// Steps between early termination checks; a whole generation when off
+static int check_interval_steps(const SimulationState* state, float dt) {
+    if (!early_termination_enabled(state)) return INT_MAX;
+    int steps = (int)(state->early.check_interval / dt + 0.5f);
+    return steps > 0 ? steps : 1;
+}
+
+// Applies the early termination rules to every active creature. `elapsed`
+// is the time since the last check.
+static void apply_termination_rules(SimulationState* state, float elapsed, float dt) {
+    PhysicsStore* ps = state->physics;
+    const EarlyTermination* rules = &state->early;
+    float remaining = state->config.sim_duration - state->sim_time;
+    PROFILE_BEGIN(PROF_RETIRE);
+
+    for (int slot = 0; slot < state->active_count; slot++) {
+        Biped* b = &state->bipeds[state->slot_creature[slot]];
+        int chest = PHYS_INDEX(ps, BIPED_CHEST, slot);
+        int pelvis = PHYS_INDEX(ps, BIPED_PELVIS, slot);
+        float fitness = biped_fitness(state, b);
+        float since_check = elapsed;
+        int retire = 0;
+        if (state->steady) {
+            // Steady-state children start between checks
+            remaining = b->steps_left * dt;
+            since_check = fminf(elapsed, (state->steady_steps - b->steps_left) * dt);
+        }
+
+        if (rules->max_torso_tilt > 0) {
+            // Screen y grows downwards, so an upright spine points to -y
+            float tilt = atan2f(fabsf(ps->x[chest] - ps->x[pelvis]), ps->y[pelvis] - ps->y[chest]);
+            if (tilt > rules->max_torso_tilt) retire = 1;
+        }
+        if (rules->stall_window > 0) {
+            b->stall_time += since_check;
+            if (b->stall_time >= rules->stall_window) {
+                if (fabsf(ps->x[pelvis] - b->stall_x) < rules->stall_distance) retire = 1;
+                b->stall_x = ps->x[pelvis];
+                b->stall_time = 0;
             }
         }
+        if (rules->max_speed > 0 && state->generation > 1) {
+            // Best case: full speed and a maximal upright bonus from here on
+            float bound = fitness + remaining * (rules->max_speed + SPINE_LENGTH * UPRIGHT_WEIGHT);
+            if (bound < state->population->elite_threshold) retire = 1;
+        }
+
+        if (retire) {
+            b->done = 1;
+            b->final_fitness = fitness;
+            b->final_pelvis_x = ps->x[pelvis];
+        }
+    }
+    PROFILE_END(PROF_RETIRE, state->active_count);
+}
+
+// Applies the early termination rules, then swaps retired creatures
+// behind the active set
+static void retire_creatures(SimulationState* state, float elapsed, float dt) {
+    apply_termination_rules(state, elapsed, dt);
+
+    // Compact: move each retired creature behind the active set
+    PhysicsStore* ps = state->physics;
+    int slot = 0;
+    while (slot < state->active_count) {
+        int creature = state->slot_creature[slot];
+        if (!state->bipeds[creature].done) {
+            slot++;
+            continue;
+        }
+        int last = --state->active_count;
+        int other = state->slot_creature[last];
+        physics_store_swap(ps, slot, last);
+        nn_batch_swap(state->controllers, slot, last);
+        state->slot_creature[slot] = other;
+        state->slot_creature[last] = creature;
+        state->bipeds[other].slot = slot;
+        state->bipeds[creature].slot = last;
     }
+}
 
-    if (state->sim_time >= SIM_DURATION) {
-        float total_fitness = 0, max_fitness = -1e9, min_fitness = 1e9;
+// Loads the instances of creatures [begin, begin + capacity) into the
+// slots, ready for their first step
+static void load_chunk(SimulationState* state, int begin) {
+    int remaining = state->config.population_size - begin;
+    state->chunk_begin = begin;
+    state->chunk_count = remaining < state->capacity ? remaining : state->capacity;
+    state->sim_time = 0;
+    for (int i = 0; i < chunk_instances(state); i++) {
+        state->bipeds[i].creature_index = begin + i / state->scenario_count;
+        state->bipeds[i].scenario = i % state->scenario_count;
+        state->bipeds[i].cached = 0;
+    }
+    assign_slots(state);
+    if (state->recorder != NULL) trajectory_discard(state->recorder);
+}
 
-        for (int i = 0; i < POPULATION_SIZE; i++) {
-            Biped* b = &state->bipeds[i];
-            float distance_moved = b->points[2]->position.x - b->start_pos.x;
-            
-            float fitness = distance_moved;
-            fitness += b->total_upright_bonus * 5.0f; // Reward for staying upright
-            fitness -= b->air_time * 20.0f; // Penalize jumping
+// Streams the trajectories of the recorded creatures of the chunk
+static void write_recorded(SimulationState* state) {
+    TrajectoryRecorder* rec = state->recorder;
+    PROFILE_BEGIN(PROF_RECORD);
+    int written = 0;
+    for (int k = 0; k < rec->creature_count; k++) {
+        if (k < state->chunk_begin || k >= state->chunk_begin + state->chunk_count) continue;
+        trajectory_write(rec, k, state->generation, k, state->population->creatures[k].fitness);
+        written++;
+    }
+    PROFILE_END(PROF_RECORD, written);
+}
 
-            if (fitness < 0) fitness = 0;
-            state->population->creatures[i].fitness = fitness;
-            total_fitness += fitness;
-            if (fitness > max_fitness) max_fitness = fitness;
-            if (fitness < min_fitness) min_fitness = fitness;
+static int compare_floats(const void* a, const void* b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+// One score from the fitness of every scenario; sorts `fitness`
+static float combine_fitness(const SimConfig* config, float* fitness, int count) {
+    if (count == 1) return fitness[0];
+    if (config->combine == COMBINE_MEAN) {
+        float total = 0;
+        for (int s = 0; s < count; s++) total += fitness[s];
+        return total / count;
+    }
+    qsort(fitness, count, sizeof(float), compare_floats);
+    if (config->combine == COMBINE_MIN) return fitness[0];
+    float position = config->quantile * (count - 1);
+    int below = (int)position;
+    if (below >= count - 1) return fitness[count - 1];
+    return fitness[below] + (fitness[below + 1] - fitness[below]) * (position - below);
+}
+
+// Behavior descriptor of a creature, averaged over its scenarios
+static Behavior creature_behavior(const SimulationState* state, const Biped* first) {
+    const PhysicsStore* ps = state->physics;
+    Behavior behavior = {{0}, first->creature_index};
+    int count = state->scenario_count;
+    for (int s = 0; s < count; s++) {
+        const Biped* b = &first[s];
+        float pelvis_x = b->done ? b->final_pelvis_x : ps->x[PHYS_INDEX(ps, BIPED_PELVIS, b->slot)];
+        float elapsed = b->elapsed > 0 ? b->elapsed : 1;
+        behavior.d[0] += (pelvis_x - b->start_pos.x) / NOVELTY_DISTANCE_SCALE;
+        behavior.d[1] += b->total_torso_angle / elapsed;
+        behavior.d[2] += b->left_contact / elapsed;
+        behavior.d[3] += b->right_contact / elapsed;
+    }
+    for (int d = 0; d < NOVELTY_DIMS; d++) behavior.d[d] /= count;
+    return behavior;
+}
+
+// Records the fitness of every creature in the chunk
+static void end_chunk(SimulationState* state) {
+    int count = state->scenario_count;
+    float scenario_fitness[count];
+    PROFILE_BEGIN(PROF_FITNESS);
+    for (int i = 0; i < state->chunk_count; i++) {
+        Biped* first = &state->bipeds[i * count];
+        float fitness;
+        if (first->cached) {
+            fitness = first->cached_fitness;
+        } else {
+            for (int s = 0; s < count; s++) {
+                Biped* b = &first[s];
+                float f = b->done ? b->final_fitness : biped_fitness(state, b);
+                scenario_fitness[s] = f < 0 ? 0 : f;
+            }
+            fitness = combine_fitness(&state->config, scenario_fitness, count);
+            if (state->fitness_cache != NULL && !early_termination_enabled(state)) {
+                fitness_cache_store(state->fitness_cache, first->genome_key, fitness);
+            }
         }
-        
-        ga_evolve(state->population);
-        
-        float avg_fitness = total_fitness / POPULATION_SIZE;
+        state->population->creatures[first->creature_index].fitness = fitness;
+        if (state->archive != NULL) state->behaviors[first->creature_index] = creature_behavior(state, first);
+    }
+    PROFILE_END(PROF_FITNESS, chunk_instances(state));
+    if (state->recorder != NULL) write_recorded(state);
+}
+
+static int last_chunk(const SimulationState* state) {
+    return state->chunk_begin + state->chunk_count >= state->config.population_size;
+}
+
+// Records the fitness stats of the population as those of the
+// generation just completed
+static void record_generation(SimulationState* state) {
+    int size = state->config.population_size;
+    float total_fitness = 0, max_fitness = -1e9, min_fitness = 1e9;
+    for (int i = 0; i < size; i++) {
+        float fitness = state->population->creatures[i].fitness;
+        total_fitness += fitness;
+        if (fitness > max_fitness) max_fitness = fitness;
+        if (fitness < min_fitness) min_fitness = fitness;
+    }
+
+    state->best_fitness = max_fitness;
+    state->avg_fitness = total_fitness / size;
+    state->worst_fitness = min_fitness;
+    if (state->history_count == state->history_capacity) {
+        state->history_capacity = state->history_capacity > 0 ? state->history_capacity * 2 : 64;
+        state->history = (FitnessRecord*)realloc(state->history, state->history_capacity * sizeof(FitnessRecord));
+    }
+    state->history[state->history_count++] = (FitnessRecord){max_fitness, state->avg_fitness, min_fitness};
+    if (state->verbose) {
         printf("Generation %d | Avg Fitness: %.2f | Best: %.2f | Worst: %.2f\n",
-               state->generation, avg_fitness, max_fitness, min_fitness);
+               state->generation, state->avg_fitness, max_fitness, min_fitness);
         fflush(stdout);
+    }
+}
+
+// Steps per steady-state evaluation, the sim_duration rounded to whole steps
+static int evaluation_steps(const SimulationState* state, float dt) {
+    int steps = (int)(state->config.sim_duration / dt + 0.5f);
+    return steps > 0 ? steps : 1;
+}
+
+// Child `k` of the current generation
+static uint64_t birth_key(const SimulationState* state, int k) {
+    return ((uint64_t)state->population->generation << 32) | (uint32_t)k;
+}
+
+typedef struct {
+    SimulationState* state;
+    int count;
+} SpawnTask;
 
-        state->sim_time = 0;
-        for (int i = 0; i < POPULATION_SIZE; i++) {
-            reset_biped(&state->bipeds[i], (Vec2D){200, GROUND_Y - 100});
+static void spawn_task(void* ctx, int task, int thread) {
+    SpawnTask* t = (SpawnTask*)ctx;
+    SimulationState* state = t->state;
+    Population* pop = state->population;
+    int begin = task * SPAWN_CHUNK;
+    int end = begin + SPAWN_CHUNK;
+    if (end > t->count) end = t->count;
+    PROFILE_BEGIN(PROF_BREED);
+    for (int i = begin; i < end; i++) {
+        int slot = state->free_slots[i];
+        Biped* b = &state->bipeds[slot];
+        void* genes = ga_spare_genome(pop, slot);
+        ga_breed_child(pop, b->birth, genes);
+        nn_batch_load_genome(state->controllers, slot, genes);
+        reset_biped(state, slot, (Vec2D){START_X, START_Y});
+        b->steps_left = state->steady_steps;
+    }
+    PROFILE_END(PROF_BREED, end - begin);
+}
+
+// Breeds a child of the current elites into each of the first `count`
+// free slots and starts simulating it. Slots are spread over the pool,
+// since every child draws from its own stream.
+static void spawn_children(SimulationState* state, int count) {
+    if (count == 0) return;
+    ga_rank_elites(state->population);
+    for (int i = 0; i < count; i++) {
+        state->bipeds[state->free_slots[i]].birth = birth_key(state, state->steady_births++);
+    }
+    SpawnTask task = {state, count};
+    pool_run(state->pool, (count + SPAWN_CHUNK - 1) / SPAWN_CHUNK, spawn_task, &task);
+}
+
+// Switches to steady-state evolution after the first generation, which
+// ran as usual: every slot gets a child of its elites
+static void start_steady(SimulationState* state, float dt) {
+    state->steady = 1;
+    state->steady_steps = evaluation_steps(state, dt);
+    state->steady_births = 0;
+    state->steady_evaluated = 0;
+    state->population->generation++;
+
+    // Slots no longer move: every one of them is always simulated
+    state->chunk_begin = 0;
+    state->chunk_count = state->capacity;
+    state->active_count = state->capacity;
+    state->sim_time = 0;
+    state->steps_since_check = 0;
+    for (int slot = 0; slot < state->capacity; slot++) {
+        state->slot_creature[slot] = slot;
+        state->bipeds[slot].slot = slot;
+        state->bipeds[slot].creature_index = -1;
+        state->bipeds[slot].scenario = 0;
+        state->bipeds[slot].cached = 0;
+        state->free_slots[slot] = slot;
+    }
+    spawn_children(state, state->capacity);
+}
+
+// Replaces the fitness of every creature with its selection score: a
+// blend of fitness and novelty, each normalized to [0, 1] over the
+// generation. The fittest creature scores above all others, so the GA
+// keeps it as creature 0. The most novel behaviors join the archive.
+// Returns the elite threshold in raw fitness, for the bound-speed rule of
+// the next generation, since the GA finds its elites by the blend.
+static float score_novelty(SimulationState* state) {
+    Population* pop = state->population;
+    int size = pop->population_size;
+    float* novelty = state->novelty_scores;
+    double start = timer_now();
+    novelty_score(state->archive, state->behaviors, size, state->novelty.neighbours, novelty, state->pool);
+
+    float min_fitness = pop->creatures[0].fitness, max_fitness = min_fitness;
+    float min_novelty = novelty[0], max_novelty = min_novelty;
+    double total_novelty = 0;
+    int fittest = 0;
+    for (int i = 0; i < size; i++) {
+        float fitness = pop->creatures[i].fitness;
+        if (fitness > max_fitness) {
+            max_fitness = fitness;
+            fittest = i;
         }
-        state->generation++;
+        if (fitness < min_fitness) min_fitness = fitness;
+        if (novelty[i] > max_novelty) max_novelty = novelty[i];
+        if (novelty[i] < min_novelty) min_novelty = novelty[i];
+        total_novelty += novelty[i];
+    }
+    state->avg_novelty = (float)(total_novelty / size);
+
+    // Ranked in the GA's scratch space, like the archive below
+    int elite_count = ga_elite_count(size, pop->elite_fraction);
+    for (int i = 0; i < size; i++) pop->ranks[i] = (CreatureRank){pop->creatures[i].fitness, i};
+    ga_select_top(pop->ranks, size, elite_count);
+    float elite_threshold = pop->ranks[0].fitness;
+    for (int i = 1; i < elite_count; i++) {
+        if (pop->ranks[i].fitness < elite_threshold) elite_threshold = pop->ranks[i].fitness;
+    }
+
+    // Archive the most novel behaviors
+    int add = state->novelty.archive_add < size ? state->novelty.archive_add : size;
+    if (add > 0) {
+        Behavior* added = (Behavior*)malloc(add * sizeof(Behavior));
+        for (int i = 0; i < size; i++) pop->ranks[i] = (CreatureRank){novelty[i], i};
+        ga_select_top(pop->ranks, size, add);
+        for (int i = 0; i < add; i++) added[i] = state->behaviors[pop->ranks[i].index];
+        novelty_archive_add(state->archive, added, add);
+        free(added);
+    }
+
+    float weight = state->novelty.weight;
+    float fitness_range = max_fitness > min_fitness ? max_fitness - min_fitness : 1;
+    float novelty_range = max_novelty > min_novelty ? max_novelty - min_novelty : 1;
+    for (int i = 0; i < size; i++) {
+        float fitness = (pop->creatures[i].fitness - min_fitness) / fitness_range;
+        float novel = (novelty[i] - min_novelty) / novelty_range;
+        pop->creatures[i].fitness = (1 - weight) * novel + weight * fitness;
+    }
+    pop->creatures[fittest].fitness = 2;
+    state->novelty_seconds += timer_now() - start;
+    return elite_threshold;
+}
+
+static void end_generation(SimulationState* state, float dt) {
+    record_generation(state);
+
+    if (state->evolution == EVOLUTION_STEADY && state->optimizer->settings.kind == OPTIMIZER_GA &&
+        state->scenario_count == 1) {
+        start_steady(state, dt);
+    } else {
+        if (state->archive != NULL) {
+            float elite_threshold = score_novelty(state);
+            optimizer_evolve(state->optimizer, state->pool);
+            state->population->elite_threshold = elite_threshold;
+        } else {
+            optimizer_evolve(state->optimizer, state->pool);
+        }
+        PROFILE_BEGIN(PROF_RESET);
+        simulation_reload(state);
+        PROFILE_END(PROF_RESET, state->chunk_count);
+    }
+    PROFILE_GENERATION_END(state->generation);
+    state->generation++;
+}
+
+// Each population_size children evaluated count as one generation
+static void end_steady_generation(SimulationState* state) {
+    record_generation(state);
+    if (state->evolution == EVOLUTION_STEADY) {
+        state->population->generation++;
+        state->steady_births = 0;
+        state->steady_evaluated = 0;
+    } else {
+        // Back to generations, bred from the population as it stands;
+        // children still being evaluated are dropped
+        optimizer_evolve(state->optimizer, state->pool);
+        simulation_reload(state);
     }
+    PROFILE_GENERATION_END(state->generation);
+    state->generation++;
 }
 
-static void render_filled_circle(SDL_Renderer* renderer, int x, int y, int radius) {
-    for (int dy = -radius; dy <= radius; dy++) {
-        for (int dx = -radius; dx <= radius; dx++) {
-            if (dx * dx + dy * dy <= radius * radius) {
-                SDL_RenderDrawPoint(renderer, x + dx, y + dy);
+// Offers every finished child to the population and refills its slot
+static void refill_slots(SimulationState* state) {
+    Population* pop = state->population;
+    int count = 0;
+    PROFILE_BEGIN(PROF_FITNESS);
+    for (int slot = 0; slot < state->capacity; slot++) {
+        Biped* b = &state->bipeds[slot];
+        if (!b->done && b->steps_left > 0) continue;
+        float fitness = b->done ? b->final_fitness : biped_fitness(state, b);
+        if (fitness < 0) fitness = 0;
+        ga_replace_poor(pop, ga_spare_genome(pop, slot), fitness, b->birth);
+        state->free_slots[count++] = slot;
+    }
+    PROFILE_END(PROF_FITNESS, count);
+
+    if (count == 0) return;
+    state->steady_evaluated += count;
+    if (state->steady_evaluated >= state->config.population_size) {
+        int carry = state->steady_evaluated - state->config.population_size;
+        end_steady_generation(state);
+        if (!state->steady) return;
+        state->steady_evaluated = carry;
+    }
+    spawn_children(state, count);
+}
+
+// Steps every slot up to `limit` steps, stopping early at the next
+// early termination check or the first child to finish its evaluation,
+// whose slot is then refilled. Returns the number of steps taken.
+static int steady_segment(SimulationState* state, float dt, int limit) {
+    int interval = check_interval_steps(state, dt);
+    int steps = limit;
+    if (interval - state->steps_since_check < steps) steps = interval - state->steps_since_check;
+    for (int slot = 0; slot < state->capacity; slot++) {
+        if (state->bipeds[slot].steps_left < steps) steps = state->bipeds[slot].steps_left;
+    }
+
+    run_steps(state, dt, steps);
+    for (int slot = 0; slot < state->capacity; slot++) state->bipeds[slot].steps_left -= steps;
+    state->steps_since_check += steps;
+    if (state->steps_since_check >= interval) {
+        apply_termination_rules(state, interval * dt, dt);
+        state->steps_since_check = 0;
+    }
+    refill_slots(state);
+    return steps;
+}
+
+// Moves on to the next chunk, or to the next generation after the last
+static void finish_chunk(SimulationState* state, float dt) {
+    end_chunk(state);
+    if (last_chunk(state)) {
+        end_generation(state, dt);
+    } else {
+        load_chunk(state, state->chunk_begin + state->chunk_count);
+    }
+}
+
+void simulation_update(SimulationState* state, float dt) {
+    if (state->steady) {
+        steady_segment(state, dt, 1);
+        return;
+    }
+    if (state->sim_time == 0) begin_chunk(state, dt);
+    state->sim_time += dt;
+    run_steps(state, dt, 1);
+
+    int interval = check_interval_steps(state, dt);
+    if (++state->steps_since_check >= interval) {
+        retire_creatures(state, interval * dt, dt);
+        state->steps_since_check = 0;
+    }
+
+    if (state->sim_time >= state->config.sim_duration || state->active_count == 0) {
+        finish_chunk(state, dt);
+    }
+}
+
+int simulation_run_generation(SimulationState* state, float dt) {
+    float duration = state->config.sim_duration;
+    int interval = check_interval_steps(state, dt);
+    int steps = 0;
+    int generation = state->generation;
+
+    while (state->generation == generation) {
+        if (state->steady) {
+            steps += steady_segment(state, dt, INT_MAX);
+            continue;
+        }
+        if (state->sim_time == 0) begin_chunk(state, dt);
+
+        // Same steps, in segments between early termination checks, as
+        // repeated simulation_update calls would take
+        while (state->sim_time < duration && state->active_count > 0) {
+            int segment = 0;
+            do {
+                state->sim_time += dt;
+                segment++;
+            } while (state->sim_time < duration && state->steps_since_check + segment < interval);
+
+            run_steps(state, dt, segment);
+            steps += segment;
+            state->steps_since_check += segment;
+            if (state->steps_since_check >= interval) {
+                retire_creatures(state, interval * dt, dt);
+                state->steps_since_check = 0;
             }
         }
+        finish_chunk(state, dt);
     }
+    return steps;
 }
 
-void simulation_render(SimulationState* state, SDL_Renderer* renderer) {
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-    for (int i = 0; i < POPULATION_SIZE; i++) {
-        Biped* b = &state->bipeds[i];
-        // Render skeleton
-        for (int j = 0; j < NUM_CONSTRAINTS; j++) {
-            SDL_RenderDrawLine(renderer,
-                b->constraints[j]->p1->position.x, b->constraints[j]->p1->position.y,
-                b->constraints[j]->p2->position.x, b->constraints[j]->p2->position.y);
-        }
-        // Render head
-        render_filled_circle(renderer, b->points[0]->position.x, b->points[0]->position.y, 8);
-    }
-    SDL_SetRenderDrawColor(renderer, 150, 150, 150, 255);
-    SDL_RenderDrawLine(renderer, 0, GROUND_Y, SCREEN_WIDTH, GROUND_Y);
-}
-
-// Biped creation
-static Biped create_biped(int creature_index, Vec2D start_pos) {
-    Biped b;
-    b.creature_index = creature_index;
-    b.start_pos = start_pos;
-
-    // Points
-    b.points[0] = create_point_mass((Vec2D){start_pos.x, start_pos.y - 30}, 1.f);  // Head
-    b.points[1] = create_point_mass((Vec2D){start_pos.x, start_pos.y}, 1.f);      // Chest
-    b.points[2] = create_point_mass((Vec2D){start_pos.x, start_pos.y + 30}, 1.f);  // Pelvis
-    b.points[3] = create_point_mass((Vec2D){start_pos.x - 15, start_pos.y + 60}, 1.f); // L Knee
-    b.points[4] = create_point_mass((Vec2D){start_pos.x - 15, start_pos.y + 90}, 1.f); // L Ankle
-    b.points[5] = create_point_mass((Vec2D){start_pos.x + 15, start_pos.y + 60}, 1.f); // R Knee
-    b.points[6] = create_point_mass((Vec2D){start_pos.x + 15, start_pos.y + 90}, 1.f); // R Ankle
-    b.points[7] = create_point_mass((Vec2D){start_pos.x - 20, start_pos.y + 30}, 1.f); // L Elbow
-    b.points[8] = create_point_mass((Vec2D){start_pos.x - 20, start_pos.y + 60}, 1.f); // L Hand
-    b.points[9] = create_point_mass((Vec2D){start_pos.x + 20, start_pos.y + 30}, 1.f); // R Elbow
-    b.points[10]= create_point_mass((Vec2D){start_pos.x + 20, start_pos.y + 60}, 1.f); // R Hand
-    
-    // Constraints
-    for (int i=0; i<NUM_CONSTRAINTS; ++i) b.constraints[i] = malloc(sizeof(Constraint));
-    *b.constraints[0] = (Constraint){b.points[0], b.points[1], 30}; // Neck
-    *b.constraints[1] = (Constraint){b.points[1], b.points[2], 30}; // Spine
-    *b.constraints[2] = (Constraint){b.points[1], b.points[7], 30}; // L Upper Arm
-    *b.constraints[3] = (Constraint){b.points[7], b.points[8], 30}; // L Forearm
-    *b.constraints[4] = (Constraint){b.points[1], b.points[9], 30}; // R Upper Arm
-    *b.constraints[5] = (Constraint){b.points[9], b.points[10], 30}; // R Forearm
-    *b.constraints[6] = (Constraint){b.points[2], b.points[3], 30}; // L Thigh
-    *b.constraints[7] = (Constraint){b.points[3], b.points[4], 30}; // L Shin
-    *b.constraints[8] = (Constraint){b.points[2], b.points[5], 30}; // R Thigh
-    *b.constraints[9] = (Constraint){b.points[5], b.points[6], 30}; // R Shin
-
-    reset_biped(&b, start_pos);
-    return b;
-}
-
-static void reset_biped(Biped* b, Vec2D start_pos) {
-    b->start_pos = start_pos;
-    b->air_time = 0;
-    b->total_upright_bonus = 0;
+void simulation_reload(SimulationState* state) {
+    state->steady = 0;
+    load_chunk(state, 0);
+}
 
-    b->points[0]->position = (Vec2D){start_pos.x, start_pos.y - 30};
-    b->points[1]->position = (Vec2D){start_pos.x, start_pos.y};
-    b->points[2]->position = (Vec2D){start_pos.x, start_pos.y + 30};
-    b->points[3]->position = (Vec2D){start_pos.x - 15, start_pos.y + 60};
-    b->points[4]->position = (Vec2D){start_pos.x - 15, start_pos.y + 90};
-    b->points[5]->position = (Vec2D){start_pos.x + 15, start_pos.y + 60};
-    b->points[6]->position = (Vec2D){start_pos.x + 15, start_pos.y + 90};
-    b->points[7]->position = (Vec2D){start_pos.x - 20, start_pos.y + 30};
-    b->points[8]->position = (Vec2D){start_pos.x - 20, start_pos.y + 60};
-    b->points[9]->position = (Vec2D){start_pos.x + 20, start_pos.y + 30};
-    b->points[10]->position= (Vec2D){start_pos.x + 20, start_pos.y + 60};
+void simulation_enable_fitness_cache(SimulationState* state) {
+    if (state->fitness_cache == NULL) {
+        state->fitness_cache = fitness_cache_create(4 * state->config.population_size);
+    }
+}
+
+int simulation_record_trajectories(SimulationState* state, const char* path, int count, float dt) {
+    simulation_stop_recording(state);
+    if (count > state->config.population_size) count = state->config.population_size;
+    // Steps of a whole evaluation, with room for the rounding of sim_time
+    int max_steps = (int)(state->config.sim_duration / dt) + 2;
+    state->recorder = trajectory_recorder_create(path, state->physics, count, max_steps, dt, state->population->seed);
+    // Steps already taken in the current chunk would be missing
+    simulation_reload(state);
+    return state->recorder != NULL;
+}
 
-    for(int i = 0; i < NUM_POINTS; i++) {
-        b->points[i]->old_position = b->points[i]->position;
+int simulation_stop_recording(SimulationState* state) {
+    if (state->recorder == NULL) return 1;
+    int ok = trajectory_recorder_close(state->recorder);
+    state->recorder = NULL;
+    return ok;
+}
+
+void simulation_set_solver(SimulationState* state, const SolverSettings* solver) {
+    state->solver = *solver;
+    if (state->solver.iterations <= 0) state->solver.iterations = CONSTRAINT_ITERATIONS;
+}
+
+void simulation_set_evolution(SimulationState* state, EvolutionMode mode) {
+    state->evolution = mode;
+}
+
+void simulation_set_optimizer(SimulationState* state, const OptimizerSettings* settings) {
+    optimizer_destroy(state->optimizer);
+    state->optimizer = optimizer_create(state->population, settings, state->pool);
+    simulation_reload(state);
+}
+
+void simulation_set_novelty(SimulationState* state, const NoveltySettings* settings) {
+    state->novelty = *settings;
+    if (settings->neighbours > 0 && state->archive == NULL) {
+        state->archive = novelty_archive_create();
+        state->behaviors = (Behavior*)malloc(state->config.population_size * sizeof(Behavior));
+        state->novelty_scores = (float*)malloc(state->config.population_size * sizeof(float));
+    } else if (settings->neighbours <= 0 && state->archive != NULL) {
+        novelty_archive_destroy(state->archive);
+        free(state->behaviors);
+        free(state->novelty_scores);
+        state->archive = NULL;
+        state->behaviors = NULL;
+        state->novelty_scores = NULL;
     }
+    // Creatures of finished chunks have no behavior yet
+    simulation_reload(state);
+}
+
+void simulation_set_early_termination(SimulationState* state, const EarlyTermination* rules) {
+    state->early = *rules;
+    if (state->early.check_interval <= 0) state->early.check_interval = 0.25f;
 }
 
-static void destroy_biped(Biped* b) {
+static void reset_biped(SimulationState* state, int index, Vec2D start_pos) {
+    Biped* b = &state->bipeds[index];
+    b->start_pos = start_pos;
+    b->air_time = 0;
+    b->total_upright_bonus = 0;
+    b->done = 0;
+    b->final_fitness = 0;
+    b->elapsed = 0;
+    b->total_torso_angle = 0;
+    b->left_contact = 0;
+    b->right_contact = 0;
+    b->stall_x = start_pos.x + biped_pose[BIPED_PELVIS].x;
+    b->stall_time = 0;
+    const Scenario* scenario = &state->scenarios[b->scenario];
+    b->push_in = scenario->push_time;
+    state->physics->terrain[b->slot] = scenario->terrain;
+
+    Vec2D pose[NUM_POINTS];
     for (int i = 0; i < NUM_POINTS; i++) {
-        free(b->points[i]);
-    }
-    for (int i = 0; i < NUM_CONSTRAINTS; i++) {
-        free(b->constraints[i]);
+        pose[i] = (Vec2D){start_pos.x + biped_pose[i].x, start_pos.y + biped_pose[i].y};
     }
+    physics_store_set_pose(state->physics, b->slot, pose);
 }
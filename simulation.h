@@ -3,35 +3,228 @@
 
 #include "physics.h"
 #include "genetics.h"
-#include <SDL.h>
+#include "optimizer.h"
+#include "threadpool.h"
+#include "fitness_cache.h"
+#include "config.h"
+#include "trajectory.h"
+#include "novelty.h"
+#include <stdint.h>
 
 #define SCREEN_WIDTH 1280
 #define SCREEN_HEIGHT 720
+#define GROUND_Y (SCREEN_HEIGHT - 100)
 
 #define NUM_POINTS 11
 #define NUM_CONSTRAINTS 10
 
+// Point indices into the biped skeleton
+enum {
+    BIPED_HEAD,
+    BIPED_CHEST,
+    BIPED_PELVIS,
+    BIPED_L_KNEE,
+    BIPED_L_ANKLE,
+    BIPED_R_KNEE,
+    BIPED_R_ANKLE,
+    BIPED_L_ELBOW,
+    BIPED_L_HAND,
+    BIPED_R_ELBOW,
+    BIPED_R_HAND
+};
+
+// Rules for retiring a creature before the end of its sim_duration: its fitness is frozen
+// and it leaves the active set. A rule set to 0 is off.
+typedef struct {
+    float max_torso_tilt;  // Radians between the spine and vertical
+    float stall_window;    // Seconds over which the pelvis must advance...
+    float stall_distance;  // ...at least this many pixels
+    float max_speed;       // Assumed top pelvis speed (px/s) for the fitness bound
+    float check_interval;  // Seconds between rule checks and compaction
+} EarlyTermination;
+
+// Conditions a genome is evaluated under. Scenario 0 is always the flat
+// ground and the fixed start without a push.
 typedef struct {
-    PointMass* points[NUM_POINTS];
-    Constraint* constraints[NUM_CONSTRAINTS];
-    int creature_index;
+    int terrain;        // Row of SimulationState.terrain
+    float start_offset; // Added to the start position along x (px)
+    float push_time;    // Seconds into the evaluation; 0 for no push
+    float push_speed;   // Change of x velocity of every point (px/s)
+} Scenario;
+
+// Per-instance fitness bookkeeping for the creatures of the current
+// chunk, one instance per creature and scenario; point state lives in
+// SimulationState.physics
+typedef struct {
+    int creature_index; // Into the population
+    int scenario;
+    int slot; // Column in the physics store and controller batch
 
     // For fitness calculation
     float air_time;
     float total_upright_bonus;
     Vec2D start_pos;
+
+    // For the behavior descriptor of novelty search
+    float elapsed; // Seconds simulated
+    float total_torso_angle;
+    float left_contact; // Seconds each foot touched the ground
+    float right_contact;
+
+    // Set when the fitness cache already knows this genome's fitness
+    int cached;
+    float cached_fitness;
+    uint64_t genome_key;
+
+    // Early termination
+    int done;
+    float final_fitness;
+    float final_pelvis_x;
+    float stall_x;
+    float stall_time;
+
+    float push_in; // Seconds until the scenario's push; <= 0 once done
+
+    // Steady-state evolution: steps left in this creature's evaluation
+    // and the key of its random streams
+    int steps_left;
+    uint64_t birth;
 } Biped;
 
+typedef enum {
+    EVOLUTION_GENERATIONAL, // Every creature finishes, then ga_evolve breeds the next generation
+    EVOLUTION_STEADY        // Each finished creature's slot gets a new child right away
+} EvolutionMode;
+
+// Fitness stats of one completed generation
+typedef struct {
+    float best;
+    float avg;
+    float worst;
+} FitnessRecord;
+
+// Bytes a configuration needs, split by what they scale with
 typedef struct {
+    size_t per_creature; // Genomes and GA bookkeeping, for every creature
+    size_t per_slot;     // Simulation state, for each creature simulated at once in all its scenarios
+    size_t cache;        // Fitness cache, 0 when off
+    size_t total;
+} MemoryEstimate;
+
+typedef struct {
+    SimConfig config;
     Population* population;
+    Optimizer* optimizer; // Breeds each generation, the GA by default
+
+    // The population is simulated in chunks of up to `capacity`
+    // creatures; the current chunk is [chunk_begin, chunk_begin +
+    // chunk_count). Everything below except the population is sized for
+    // one chunk. Each creature runs as scenario_count instances, whose
+    // bipeds are adjacent: instance s of creature chunk_begin + i is
+    // biped i * scenario_count + s.
+    int capacity;
+    int chunk_begin;
+    int chunk_count;
+    int scenario_count;
+    Scenario* scenarios;
+    Heightfield* terrain; // NULL while every scenario is flat
+
     Biped* bipeds;
+    PhysicsStore* physics;
+    ThreadPool* pool;
+
+    // Batched controllers and their packed [neuron][creature] I/O matrices
+    NNBatch* controllers;
+    float* nn_inputs;
+    float* nn_outputs;
+
+    // Instances still being simulated occupy slots [0, active_count).
+    // Cached and retired ones are swapped behind them.
+    int* slot_creature;
+    int active_count;
+
+    FitnessCache* fitness_cache; // Optional
+
+    // Novelty search, off while `archive` is NULL: each generation is bred
+    // from a blend of fitness and novelty rather than fitness alone
+    NoveltySettings novelty;
+    NoveltyArchive* archive;
+    Behavior* behaviors; // [population_size], of the current generation
+    float* novelty_scores; // [population_size]
+    float avg_novelty; // Of the most recently completed generation
+    double novelty_seconds;
+    TrajectoryRecorder* recorder; // Optional
+    EarlyTermination early;
+    int steps_since_check;
+    long long creature_steps; // Creature-steps actually simulated, for throughput
+
+    // Steady-state evolution runs the first generation as usual, then
+    // keeps every slot busy with children of the current elites. Each
+    // population_size children evaluated count as a generation.
+    EvolutionMode evolution; // Steady-state needs the GA optimizer and one scenario
+    int steady; // Past the first generation of steady-state evolution
+    int steady_steps; // Steps per evaluation
+    int steady_births; // Children started this generation
+    int steady_evaluated; // Children finished this generation
+    int* free_slots;
+
+    SolverSettings solver;
+    long long solver_sweeps;      // Constraint sweeps over SIMD blocks...
+    long long solver_block_steps; // ...and block-steps they were spread over
+
     int generation;
-    float sim_time;
+    float sim_time; // Into the current chunk
+    int verbose; // Print a line per completed generation
+
+    // Fitness stats of the most recently completed generation
+    float best_fitness;
+    float avg_fitness;
+    float worst_fitness;
+
+    // Stats of every completed generation, oldest first
+    FitnessRecord* history;
+    int history_count;
+    int history_capacity;
 } SimulationState;
 
-SimulationState* simulation_create();
+SimulationState* simulation_create(const SimConfig* config, uint64_t seed, int thread_count);
 void simulation_destroy(SimulationState* state);
+// Genes in the genome of one controller
+int simulation_gene_count(const SimConfig* config);
+void simulation_estimate_memory(const SimConfig* config, int use_cache, MemoryEstimate* estimate);
+// Checks `config` against its memory budget, first shrinking an unset
+// chunk size until it fits. Returns 0 if it cannot fit.
+int simulation_fit_memory_budget(SimConfig* config, int use_cache, MemoryEstimate* estimate);
+// Skips re-simulating genomes whose fitness is already known. Assumes
+// the same dt for every step of a generation.
+void simulation_enable_fitness_cache(SimulationState* state);
+// Streams the trajectories of creatures [0, count) of every generation
+// to `path` (trajectory.h). They are always simulated, never taken from
+// the fitness cache. Steady-state children are not recorded. Returns 0
+// if the file cannot be created.
+int simulation_record_trajectories(SimulationState* state, const char* path, int count, float dt);
+// Finishes the trajectory file. Returns 0 if any write failed.
+int simulation_stop_recording(SimulationState* state);
+// Turns novelty search on, or off for settings->neighbours == 0, and
+// starts the current generation over. Needs generational evolution with
+// the GA optimizer. The fitness cache is bypassed, since it knows no
+// behaviors.
+void simulation_set_novelty(SimulationState* state, const NoveltySettings* settings);
+void simulation_set_early_termination(SimulationState* state, const EarlyTermination* rules);
+void simulation_set_solver(SimulationState* state, const SolverSettings* solver);
+// Takes effect at the end of the current generation
+void simulation_set_evolution(SimulationState* state, EvolutionMode mode);
+// Replaces the optimizer, which writes the genomes of its first generation
+// into the population, and starts the current generation over with them
+void simulation_set_optimizer(SimulationState* state, const OptimizerSettings* settings);
+// Starts the current generation over, from its first chunk and the
+// population's genomes, e.g. after they were restored from a checkpoint
+void simulation_reload(SimulationState* state);
+// Advances one step, joining the worker threads once per step
 void simulation_update(SimulationState* state, float dt);
-void simulation_render(SimulationState* state, SDL_Renderer* renderer);
+// Runs the rest of the current generation, joining the workers once per
+// chunk.
+// Returns the number of steps taken.
+int simulation_run_generation(SimulationState* state, float dt);
 
 #endif // SIMULATION_H
@@ -0,0 +1,74 @@
+#include "snapshot.h"
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAPSHOT_FRESH 4
+
+SnapshotBuffer* snapshot_buffer_create(const SimulationState* state) {
+    const PhysicsStore* ps = state->physics;
+    int count = ps->creature_count;
+    size_t plane = (size_t)ps->point_count * count;
+
+    SnapshotBuffer* buffer = (SnapshotBuffer*)malloc(sizeof(SnapshotBuffer));
+    for (int i = 0; i < 3; i++) {
+        Snapshot* s = &buffer->buffers[i];
+        s->creature_count = count;
+        s->point_count = ps->point_count;
+        s->constraints = ps->constraints;
+        s->constraint_count = ps->constraint_count;
+        s->ground = state->terrain;
+        s->x = (float*)malloc(4 * plane * sizeof(float));
+        s->y = s->x + plane;
+        s->old_x = s->y + plane;
+        s->old_y = s->old_x + plane;
+    }
+    buffer->back = 0;
+    buffer->front = 1;
+    atomic_init(&buffer->middle, 2);
+    buffer->sequence = 0;
+
+    // The consumer starts on a copy of the current state
+    snapshot_publish(buffer, state, 0);
+    snapshot_acquire(buffer);
+    return buffer;
+}
+
+void snapshot_buffer_destroy(SnapshotBuffer* buffer) {
+    for (int i = 0; i < 3; i++) {
+        free(buffer->buffers[i].x);
+    }
+    free(buffer);
+}
+
+void snapshot_publish(SnapshotBuffer* buffer, const SimulationState* state, float alpha) {
+    const PhysicsStore* ps = state->physics;
+    Snapshot* s = &buffer->buffers[buffer->back];
+    size_t row = s->creature_count * sizeof(float);
+    for (int p = 0; p < s->point_count; p++) {
+        int from = PHYS_INDEX(ps, p, 0);
+        int to = p * s->creature_count;
+        memcpy(&s->x[to], &ps->x[from], row);
+        memcpy(&s->y[to], &ps->y[from], row);
+        memcpy(&s->old_x[to], &ps->old_x[from], row);
+        memcpy(&s->old_y[to], &ps->old_y[from], row);
+    }
+    s->alpha = alpha;
+    s->publish_time = timer_now();
+    s->slot_count = state->chunk_count * state->scenario_count;
+    s->active_count = state->active_count;
+    s->generation = state->generation;
+    s->sim_time = state->sim_time;
+    s->best_fitness = state->best_fitness;
+    s->sequence = ++buffer->sequence;
+
+    // Release the filled buffer and take whichever one was in the middle
+    buffer->back = atomic_exchange_explicit(&buffer->middle, buffer->back | SNAPSHOT_FRESH, memory_order_acq_rel) & ~SNAPSHOT_FRESH;
+}
+
+const Snapshot* snapshot_acquire(SnapshotBuffer* buffer) {
+    if (atomic_load_explicit(&buffer->middle, memory_order_relaxed) & SNAPSHOT_FRESH) {
+        buffer->front = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel) & ~SNAPSHOT_FRESH;
+    }
+    return &buffer->buffers[buffer->front];
+}
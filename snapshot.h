@@ -0,0 +1,52 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "simulation.h"
+#include <stdatomic.h>
+
+// What the view needs of one simulation step: point positions of every
+// slot after the step and before it, packed [point][creature] without
+// SIMD padding, plus progress.
+typedef struct {
+    int creature_count; // Slots per row: the simulation's chunk capacity
+    int point_count;
+    const ConstraintDef* constraints; // Shared skeleton, immutable
+    int constraint_count;
+    const Heightfield* ground; // Scenario terrain, immutable; NULL for flat ground
+
+    float* x;
+    float* y;
+    float* old_x; // Verlet keeps the previous step's positions anyway
+    float* old_y;
+    float alpha;         // Fraction of the next step already due when published
+    double publish_time; // timer_now() at publish
+    int slot_count;   // Slots [0, slot_count) hold the current chunk's creatures
+    int active_count; // Slots [0, active_count) are still being simulated
+    int generation;
+    float sim_time;
+    float best_fitness; // Of the last completed generation
+
+    long long sequence; // Bumped by every publish
+} Snapshot;
+
+// Lock-free triple buffer between one producer (the simulation thread)
+// and one consumer (the render thread). The producer fills `back` and
+// swaps it with `middle`; the consumer swaps `front` with `middle` when a
+// newer snapshot is there. Neither side ever waits for the other.
+typedef struct {
+    Snapshot buffers[3];
+    atomic_int middle; // Buffer index, plus SNAPSHOT_FRESH when unread
+    int back;          // Producer only
+    int front;         // Consumer only
+    long long sequence;
+} SnapshotBuffer;
+
+SnapshotBuffer* snapshot_buffer_create(const SimulationState* state);
+void snapshot_buffer_destroy(SnapshotBuffer* buffer);
+// Producer side: copies the current positions and makes them visible.
+// alpha is the fixed-timestep accumulator's leftover over dt.
+void snapshot_publish(SnapshotBuffer* buffer, const SimulationState* state, float alpha);
+// Consumer side: the newest published snapshot. Valid until the next call.
+const Snapshot* snapshot_acquire(SnapshotBuffer* buffer);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,413 @@
+#include "sweep.h"
+#include "rng.h"
+#include "timer.h"
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SWEEP_SEED_SALT 0xD6E8FEB86659FD93ULL // Keeps the draws of the search apart from the runs'
+
+// Parses all of `text` as a number
+static int parse_number(const char* text, double* out) {
+    char* end;
+    *out = strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+static int parse_count(const char* text, int min, int* out) {
+    double v;
+    // Range first: converting an out-of-range double to int is undefined
+    if (!parse_number(text, &v) || v < min || v > INT_MAX || v != (int)v) return 0;
+    *out = (int)v;
+    return 1;
+}
+
+// "low..high", optionally followed by "log"
+static int parse_range(SweepParam* p, char* value) {
+    char* dots = strstr(value, "..");
+    *dots = '\0';
+    char* low = config_trim(value);
+    char* high = dots + 2;
+    while (isspace((unsigned char)*high)) high++;
+    char* rest = high;
+    while (*rest != '\0' && !isspace((unsigned char)*rest)) rest++;
+    if (*rest != '\0') *rest++ = '\0';
+    rest = config_trim(rest);
+
+    if (!parse_number(low, &p->low) || !parse_number(high, &p->high) || p->low > p->high) return 0;
+    if (strcmp(rest, "log") == 0) {
+        p->log_scale = 1;
+        if (p->low <= 0) return 0;
+    } else if (*rest != '\0') {
+        return 0;
+    }
+    p->integer = strpbrk(low, ".eE") == NULL && strpbrk(high, ".eE") == NULL;
+    p->value_count = 0;
+    return 1;
+}
+
+// "a, b, c"
+static int parse_list(SweepParam* p, char* value) {
+    p->value_count = 0;
+    for (char* item = strtok(value, ","); item != NULL; item = strtok(NULL, ",")) {
+        item = config_trim(item);
+        if (*item == '\0' || strlen(item) >= SWEEP_VALUE_MAX || p->value_count == SWEEP_MAX_VALUES) return 0;
+        strcpy(p->values[p->value_count++], item);
+    }
+    return p->value_count > 0;
+}
+
+static int parse_param(SweepSpec* spec, const char* key, char* value) {
+    for (int i = 0; i < spec->param_count; i++) {
+        if (strcmp(spec->params[i].key, key) == 0) {
+            printf("%s is swept twice\n", key);
+            return 0;
+        }
+    }
+    if (spec->param_count == SWEEP_MAX_PARAMS || strlen(key) >= SWEEP_VALUE_MAX) {
+        printf("Too many swept keys\n");
+        return 0;
+    }
+    SweepParam* p = &spec->params[spec->param_count];
+    memset(p, 0, sizeof(SweepParam));
+    strcpy(p->key, key);
+    int ok = strstr(value, "..") != NULL ? parse_range(p, value) : parse_list(p, value);
+    if (!ok) {
+        printf("Bad values for %s (expected 'a, b, c' or 'low..high' with an optional 'log')\n", key);
+        return 0;
+    }
+    spec->param_count++;
+    return 1;
+}
+
+static int parse_line(const char* key, char* value, void* ctx) {
+    SweepSpec* spec = (SweepSpec*)ctx;
+    if (strcmp(key, "search") == 0) {
+        if (strcmp(value, "grid") == 0) {
+            spec->search = SWEEP_GRID;
+        } else if (strcmp(value, "random") == 0) {
+            spec->search = SWEEP_RANDOM;
+        } else {
+            printf("Unknown search %s (expected grid or random)\n", value);
+            return 0;
+        }
+        return 1;
+    }
+    int* count = NULL;
+    int min = 0;
+    if (strcmp(key, "samples") == 0) {
+        count = &spec->samples;
+        min = 1;
+    } else if (strcmp(key, "rung") == 0) {
+        count = &spec->rung;
+        min = 0;
+    } else if (strcmp(key, "eta") == 0) {
+        count = &spec->eta;
+        min = 2;
+    }
+    if (count != NULL) {
+        if (!parse_count(value, min, count)) {
+            printf("Bad value '%s' for %s (expected a whole number of at least %d)\n", value, key, min);
+            return 0;
+        }
+        return 1;
+    }
+    if (!config_has_key(key)) {
+        printf("Unknown sweep key %s\n", key);
+        return 0;
+    }
+    return parse_param(spec, key, value);
+}
+
+int sweep_load(SweepSpec* spec, const char* path) {
+    spec->search = SWEEP_GRID;
+    spec->samples = DEFAULT_SWEEP_SAMPLES;
+    spec->rung = 0;
+    spec->eta = DEFAULT_SWEEP_ETA;
+    spec->param_count = 0;
+
+    if (!config_parse_file(path, "sweep", parse_line, spec)) return 0;
+
+    for (int i = 0; i < spec->param_count; i++) {
+        if (spec->search == SWEEP_GRID && spec->params[i].value_count == 0) {
+            printf("Grid search needs listed values for %s, not a range\n", spec->params[i].key);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Value of `p` for random sample `rng` as text
+static void draw_value(const SweepParam* p, Rng* rng, char* out) {
+    if (p->value_count > 0) {
+        strcpy(out, p->values[rng_int(rng, p->value_count)]);
+        return;
+    }
+    double v;
+    if (p->log_scale) {
+        v = exp(log(p->low) + rng_float(rng) * (log(p->high) - log(p->low)));
+    } else if (p->integer) {
+        v = p->low + rng_int(rng, (int)(p->high - p->low) + 1);
+    } else {
+        v = p->low + rng_float(rng) * (p->high - p->low);
+    }
+    if (p->integer) {
+        v = floor(v + 0.5);
+        if (v > p->high) v = p->high;
+        snprintf(out, SWEEP_VALUE_MAX, "%.0f", v);
+    } else {
+        snprintf(out, SWEEP_VALUE_MAX, "%.6g", v);
+    }
+}
+
+SweepExperiment* sweep_plan(const SweepSpec* spec, const SimConfig* base, uint64_t seed, int* count) {
+    long long n = 1;
+    if (spec->search == SWEEP_GRID) {
+        for (int i = 0; i < spec->param_count && n <= SWEEP_MAX_EXPERIMENTS; i++) n *= spec->params[i].value_count;
+    } else {
+        n = spec->samples;
+    }
+    if (n > SWEEP_MAX_EXPERIMENTS) {
+        printf("The sweep has more than %d configurations\n", SWEEP_MAX_EXPERIMENTS);
+        return NULL;
+    }
+
+    SweepExperiment* experiments = (SweepExperiment*)calloc(n, sizeof(SweepExperiment));
+    for (int e = 0; e < n; e++) {
+        SweepExperiment* experiment = &experiments[e];
+        if (spec->search == SWEEP_GRID) {
+            // The last key varies fastest
+            int index = e;
+            for (int i = spec->param_count - 1; i >= 0; i--) {
+                const SweepParam* p = &spec->params[i];
+                strcpy(experiment->values[i], p->values[index % p->value_count]);
+                index /= p->value_count;
+            }
+        } else {
+            // Each sample has its own stream, so it does not depend on
+            // how many are drawn
+            Rng rng;
+            rng_seed(&rng, seed ^ SWEEP_SEED_SALT, (uint64_t)e);
+            for (int i = 0; i < spec->param_count; i++) draw_value(&spec->params[i], &rng, experiment->values[i]);
+        }
+
+        experiment->config = *base;
+        for (int i = 0; i < spec->param_count; i++) {
+            if (!config_set(&experiment->config, spec->params[i].key, experiment->values[i])) {
+                printf("  in the sweep of %s\n", spec->params[i].key);
+                free(experiments);
+                return NULL;
+            }
+        }
+    }
+    *count = (int)n;
+    return experiments;
+}
+
+typedef struct {
+    const SweepSpec* spec;
+    SweepExperiment* experiments;
+    int count;
+    uint64_t seed;
+    float dt;
+    int generations;
+    SweepSetupFn setup;
+    void* ctx;
+    SweepStats* stats;
+
+    pthread_mutex_t lock; // Guards everything below and the scheduling fields of the experiments
+    pthread_cond_t wake;  // An experiment finished a generation, or a rung ended
+    int rung_end; // Generation every running configuration reaches before the next halving
+    int live;     // Experiments neither stopped nor done
+    CreatureRank* ranks;
+} Sweep;
+
+// The waiting experiment with the fewest generations, or NULL
+static SweepExperiment* next_experiment(Sweep* sweep) {
+    SweepExperiment* next = NULL;
+    for (int i = 0; i < sweep->count; i++) {
+        SweepExperiment* e = &sweep->experiments[i];
+        if (e->stopped || e->running || e->generations >= sweep->rung_end) continue;
+        if (next == NULL || e->generations < next->generations) next = e;
+    }
+    return next;
+}
+
+static void end_experiment(SweepExperiment* e) {
+    if (e->sim == NULL) return;
+    e->creature_steps = e->sim->creature_steps;
+    simulation_destroy(e->sim);
+    e->sim = NULL;
+}
+
+// Trains the next generation of `e`, outside the lock
+static void train_generation(Sweep* sweep, SweepExperiment* e) {
+    double start = timer_now();
+    if (e->sim == NULL) {
+        e->sim = simulation_create(&e->config, sweep->seed, 1);
+        e->sim->verbose = 0;
+        if (sweep->setup != NULL) sweep->setup(e->sim, sweep->ctx);
+    }
+    SimulationState* sim = e->sim;
+    int generation = sim->generation;
+    while (sim->generation == generation) simulation_run_generation(sim, sweep->dt);
+
+    e->best[e->generations] = sim->best_fitness;
+    e->avg[e->generations] = sim->avg_fitness;
+    e->generations++;
+    if (e->generations == sweep->generations) end_experiment(e);
+    e->seconds += timer_now() - start;
+}
+
+// Once every running configuration has reached the rung, stops all but
+// the best 1/eta of them by the best fitness of their last generation
+static void end_rung(Sweep* sweep) {
+    int n = 0;
+    for (int i = 0; i < sweep->count; i++) {
+        const SweepExperiment* e = &sweep->experiments[i];
+        if (e->stopped || e->generations == sweep->generations) continue;
+        if (e->running || e->generations < sweep->rung_end) return;
+        sweep->ranks[n].fitness = e->best[e->generations - 1];
+        sweep->ranks[n].index = i;
+        n++;
+    }
+    // Nothing is left to halve
+    if (n == 0) return;
+
+    int keep = (n + sweep->spec->eta - 1) / sweep->spec->eta;
+    ga_select_top(sweep->ranks, n, keep);
+    float cut = sweep->ranks[0].fitness;
+    for (int k = 1; k < keep; k++) {
+        if (sweep->ranks[k].fitness < cut) cut = sweep->ranks[k].fitness;
+    }
+    for (int k = keep; k < n; k++) {
+        SweepExperiment* e = &sweep->experiments[sweep->ranks[k].index];
+        e->stopped = 1;
+        end_experiment(e);
+        sweep->live--;
+    }
+    sweep->stats->rungs++;
+    printf("Rung at generation %d: kept %d of %d configurations (best fitness at least %.2f)\n", sweep->rung_end,
+           keep, n, cut);
+    sweep->rung_end *= sweep->spec->eta;
+    if (sweep->rung_end > sweep->generations) sweep->rung_end = sweep->generations;
+}
+
+// One per pool thread: trains generations until no configuration is left
+static void sweep_worker(void* ctx, int task, int thread) {
+    (void)task;
+    (void)thread;
+    Sweep* sweep = (Sweep*)ctx;
+    pthread_mutex_lock(&sweep->lock);
+    while (sweep->live > 0) {
+        SweepExperiment* e = next_experiment(sweep);
+        if (e == NULL) {
+            pthread_cond_wait(&sweep->wake, &sweep->lock);
+            continue;
+        }
+        e->running = 1;
+        pthread_mutex_unlock(&sweep->lock);
+
+        train_generation(sweep, e);
+
+        pthread_mutex_lock(&sweep->lock);
+        e->running = 0;
+        if (e->generations == sweep->generations) {
+            sweep->live--;
+        } else if (sweep->rung_end < sweep->generations) {
+            end_rung(sweep);
+        }
+        pthread_cond_broadcast(&sweep->wake);
+    }
+    pthread_mutex_unlock(&sweep->lock);
+}
+
+void sweep_run(const SweepSpec* spec, SweepExperiment* experiments, int count, uint64_t seed, int threads,
+               float dt, int generations, SweepSetupFn setup, void* ctx, SweepStats* stats) {
+    Sweep sweep = {spec, experiments, count, seed, dt, generations, setup, ctx, stats};
+    pthread_mutex_init(&sweep.lock, NULL);
+    pthread_cond_init(&sweep.wake, NULL);
+    sweep.rung_end = spec->rung > 0 && spec->rung < generations ? spec->rung : generations;
+    sweep.live = count;
+    sweep.ranks = (CreatureRank*)malloc(count * sizeof(CreatureRank));
+    for (int i = 0; i < count; i++) {
+        experiments[i].best = (float*)calloc(generations, sizeof(float));
+        experiments[i].avg = (float*)calloc(generations, sizeof(float));
+    }
+    memset(stats, 0, sizeof(SweepStats));
+    stats->experiments = count;
+
+    // Experiments train single-threaded, side by side, so there is no
+    // point in more workers than experiments
+    int workers = threads < count ? threads : count;
+    ThreadPool* pool = pool_create(workers);
+    double start = timer_now();
+    pool_run(pool, workers, sweep_worker, &sweep);
+    stats->seconds = timer_now() - start;
+    pool_destroy(pool);
+
+    for (int i = 0; i < count; i++) {
+        stats->generations += experiments[i].generations;
+        stats->creature_steps += experiments[i].creature_steps;
+    }
+    free(sweep.ranks);
+    pthread_mutex_destroy(&sweep.lock);
+    pthread_cond_destroy(&sweep.wake);
+}
+
+int sweep_write_results(const char* path, const SweepSpec* spec, const SweepExperiment* experiments, int count,
+                        int generations) {
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        printf("Could not open %s for writing\n", path);
+        return 0;
+    }
+    fprintf(f, "experiment");
+    for (int e = 0; e < count; e++) fprintf(f, ",%d", e);
+    for (int i = 0; i < spec->param_count; i++) {
+        fprintf(f, "\n%s", spec->params[i].key);
+        for (int e = 0; e < count; e++) fprintf(f, ",%s", experiments[e].values[i]);
+    }
+    fprintf(f, "\ngenerations");
+    for (int e = 0; e < count; e++) fprintf(f, ",%d", experiments[e].generations);
+    fprintf(f, "\nfinal_best");
+    for (int e = 0; e < count; e++) {
+        const SweepExperiment* experiment = &experiments[e];
+        if (experiment->generations == 0) {
+            fprintf(f, ",");
+        } else {
+            fprintf(f, ",%f", experiment->best[experiment->generations - 1]);
+        }
+    }
+    fprintf(f, "\nseconds");
+    for (int e = 0; e < count; e++) fprintf(f, ",%.3f", experiments[e].seconds);
+
+    for (int curve = 0; curve < 2; curve++) {
+        for (int g = 1; g <= generations; g++) {
+            fprintf(f, "\n%s_%d", curve == 0 ? "best" : "avg", g);
+            for (int e = 0; e < count; e++) {
+                const SweepExperiment* experiment = &experiments[e];
+                if (g > experiment->generations) {
+                    fprintf(f, ",");
+                } else {
+                    fprintf(f, ",%f", curve == 0 ? experiment->best[g - 1] : experiment->avg[g - 1]);
+                }
+            }
+        }
+    }
+    fprintf(f, "\n");
+    return fclose(f) == 0;
+}
+
+void sweep_release(SweepExperiment* experiments, int count) {
+    for (int i = 0; i < count; i++) {
+        end_experiment(&experiments[i]);
+        free(experiments[i].best);
+        free(experiments[i].avg);
+    }
+    free(experiments);
+}
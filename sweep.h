@@ -0,0 +1,91 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "simulation.h"
+
+#define SWEEP_MAX_PARAMS 16
+#define SWEEP_MAX_VALUES 64
+#define SWEEP_MAX_EXPERIMENTS 4096
+#define SWEEP_VALUE_MAX 32 // Bytes of one value as text
+#define DEFAULT_SWEEP_SAMPLES 16
+#define DEFAULT_SWEEP_ETA 3
+
+typedef enum {
+    SWEEP_GRID,  // Every combination of the listed values
+    SWEEP_RANDOM // `samples` independent draws
+} SweepSearch;
+
+// One swept config key: either listed values, or for random search a
+// range to draw from
+typedef struct {
+    char key[SWEEP_VALUE_MAX];
+    char values[SWEEP_MAX_VALUES][SWEEP_VALUE_MAX];
+    int value_count; // 0 for a range
+    double low, high;
+    int log_scale; // Draw the range uniformly in log space
+    int integer;   // Draw whole numbers; both bounds were written as integers
+} SweepParam;
+
+// What to search, read from a file of "key = value" lines like a config
+// file: "search", "samples", "rung" and "eta" set up the search, and any
+// config key sets what it sweeps, as "a, b, c" or as "low..high" with an
+// optional "log".
+typedef struct {
+    SweepSearch search;
+    int samples;
+    // Successive halving: after `rung` generations, and then after every
+    // eta times as many, all but the best 1/eta of the running
+    // configurations stop. 0 turns it off.
+    int rung;
+    int eta;
+    SweepParam params[SWEEP_MAX_PARAMS];
+    int param_count;
+} SweepSpec;
+
+// One configuration and its learning curve
+typedef struct {
+    SimConfig config;
+    char values[SWEEP_MAX_PARAMS][SWEEP_VALUE_MAX]; // Of each swept key, as set
+    SimulationState* sim; // While it trains
+    int generations;      // Trained so far
+    int stopped;          // Stopped by successive halving
+    int running;          // A worker is training it
+    float* best;          // [generation - 1] of the sweep's generation budget
+    float* avg;
+    double seconds;       // Worker time spent on it
+    long long creature_steps;
+} SweepExperiment;
+
+typedef struct {
+    int experiments;
+    int generations;       // Trained in all
+    int rungs;             // Halvings done
+    long long creature_steps;
+    double seconds;        // Wall time
+} SweepStats;
+
+// Configures a freshly created experiment, like an IslandSetupFn
+typedef void (*SweepSetupFn)(SimulationState* sim, void* ctx);
+
+// Reads a spec file. Prints and returns 0 on error.
+int sweep_load(SweepSpec* spec, const char* path);
+// The configurations of the sweep: `base` with the swept keys set. Random
+// draws depend only on `seed`. Returns a malloc'd array, or NULL after
+// printing why a value is invalid.
+SweepExperiment* sweep_plan(const SweepSpec* spec, const SimConfig* base, uint64_t seed, int* count);
+// Trains every experiment for up to `generations` generations, each from
+// `seed` with a single thread, on a pool of `threads` workers. A free
+// worker always takes the running configuration with the fewest
+// generations, so they advance together; at each rung the workers wait
+// until every configuration has reached it, so which configurations stop
+// depends only on their fitness, never on timing.
+void sweep_run(const SweepSpec* spec, SweepExperiment* experiments, int count, uint64_t seed, int threads,
+               float dt, int generations, SweepSetupFn setup, void* ctx, SweepStats* stats);
+// Writes one column per experiment: its swept values, the generations it
+// trained, its final best fitness and its best and average fitness in
+// each generation, left empty once stopped. Returns 0 on error.
+int sweep_write_results(const char* path, const SweepSpec* spec, const SweepExperiment* experiments, int count,
+                        int generations);
+void sweep_release(SweepExperiment* experiments, int count);
+
+#endif // SWEEP_H
@@ -0,0 +1,166 @@
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Every thread starts on its own contiguous slice of the task range and
+// steals from the other slices once its own runs dry, so uneven tasks
+// still keep all threads busy.
+typedef struct {
+    atomic_int next;
+    int end;
+    char pad[56]; // Keep slices on separate cache lines
+} TaskSlice;
+
+typedef struct {
+    ThreadPool* pool;
+    int index;
+} Worker;
+
+struct ThreadPool {
+    int thread_count;
+    pthread_t* threads;
+    Worker* workers;
+    TaskSlice* slices;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+    int job_id;   // Bumped by every pool_run
+    int active;   // Background workers still busy with the current job
+    int shutdown;
+
+    PoolTaskFn fn;
+    void* ctx;
+};
+
+static void run_tasks(ThreadPool* pool, int thread) {
+    int n = pool->thread_count;
+    for (int k = 0; k < n; k++) {
+        TaskSlice* slice = &pool->slices[(thread + k) % n];
+        for (;;) {
+            int task = atomic_fetch_add(&slice->next, 1);
+            if (task >= slice->end) break;
+            pool->fn(pool->ctx, task, thread);
+        }
+    }
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = (Worker*)arg;
+    ThreadPool* pool = worker->pool;
+    int seen_job = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->job_id == seen_job && !pool->shutdown) {
+            pthread_cond_wait(&pool->start_cond, &pool->lock);
+        }
+        if (pool->shutdown) break;
+        seen_job = pool->job_id;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_tasks(pool, worker->index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) pthread_cond_signal(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ThreadPool* pool_create(int thread_count) {
+    if (thread_count < 1) thread_count = 1;
+    ThreadPool* pool = (ThreadPool*)malloc(sizeof(ThreadPool));
+    pool->thread_count = thread_count;
+    pool->threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+    pool->workers = (Worker*)malloc(thread_count * sizeof(Worker));
+    pool->slices = (TaskSlice*)malloc(thread_count * sizeof(TaskSlice));
+    pool->job_id = 0;
+    pool->active = 0;
+    pool->shutdown = 0;
+    pool->fn = NULL;
+    pool->ctx = NULL;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (int i = 0; i < thread_count; i++) {
+        atomic_init(&pool->slices[i].next, 0);
+        pool->slices[i].end = 0;
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+    }
+    // Thread 0 is the caller of pool_run
+    for (int i = 1; i < thread_count; i++) {
+        pthread_create(&pool->threads[i], NULL, worker_main, &pool->workers[i]);
+    }
+    return pool;
+}
+
+void pool_destroy(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool->slices);
+    free(pool);
+}
+
+int pool_thread_count(const ThreadPool* pool) {
+    return pool->thread_count;
+}
+
+void pool_run(ThreadPool* pool, int task_count, PoolTaskFn fn, void* ctx) {
+    if (task_count <= 0) return;
+    int n = pool->thread_count;
+    if (n == 1 || task_count == 1) {
+        for (int i = 0; i < task_count; i++) fn(ctx, i, 0);
+        return;
+    }
+
+    for (int t = 0; t < n; t++) {
+        atomic_store(&pool->slices[t].next, (int)((long long)task_count * t / n));
+        pool->slices[t].end = (int)((long long)task_count * (t + 1) / n);
+    }
+    pool->fn = fn;
+    pool->ctx = ctx;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->active = n - 1;
+    pool->job_id++;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_tasks(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int pool_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
@@ -0,0 +1,19 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// Fixed set of worker threads for data-parallel loops. The calling thread
+// takes part as thread 0, so a pool of 1 runs everything inline.
+typedef struct ThreadPool ThreadPool;
+
+// fn is called once per task index in [0, task_count); thread is the index
+// of the executing thread in [0, thread_count).
+typedef void (*PoolTaskFn)(void* ctx, int task, int thread);
+
+ThreadPool* pool_create(int thread_count);
+void pool_destroy(ThreadPool* pool);
+int pool_thread_count(const ThreadPool* pool);
+// Runs all tasks and returns once every one of them has finished
+void pool_run(ThreadPool* pool, int task_count, PoolTaskFn fn, void* ctx);
+int pool_cpu_count(void);
+
+#endif // THREADPOOL_H
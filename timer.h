@@ -0,0 +1,22 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+// Monotonic wall-clock time in seconds, for throughput reporting.
+#ifdef _WIN32
+#include <windows.h>
+static inline double timer_now(void) {
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+}
+#else
+#include <time.h>
+static inline double timer_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+#endif
+
+#endif // TIMER_H
@@ -0,0 +1,304 @@
+#include "trajectory.h"
+#include "timer.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUANT_LIMIT ((float)(1 << 26)) // Keeps predictions and residuals within int32
+#define VARINT_MAX_BYTES 5
+
+static size_t align_up(size_t n, size_t alignment) {
+    return (n + alignment - 1) / alignment * alignment;
+}
+
+static int32_t quantize(float v, float inverse_quantum) {
+    float q = v * inverse_quantum;
+    if (!(q > -QUANT_LIMIT)) q = -QUANT_LIMIT; // NaN included
+    if (q > QUANT_LIMIT) q = QUANT_LIMIT;
+    return (int32_t)lrintf(q);
+}
+
+static unsigned char* put_varint(unsigned char* p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+// Returns NULL if the varint runs past `end` or is too long
+static const unsigned char* get_varint(const unsigned char* p, const unsigned char* end, uint32_t* v) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 7 * VARINT_MAX_BYTES; shift += 7) {
+        if (p == end) return NULL;
+        unsigned char byte = *p++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *v = value;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Prediction of a coordinate from its two previous quantized values
+static int32_t predict(int step, int32_t previous, int32_t before) {
+    if (step == 0) return 0;
+    if (step == 1) return previous;
+    return 2 * previous - before;
+}
+
+TrajectoryRecorder* trajectory_recorder_create(const char* path, const PhysicsStore* skeleton, int creature_count,
+                                               int max_steps, float dt, uint64_t seed) {
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) {
+        printf("Could not open %s for writing\n", path);
+        return NULL;
+    }
+    TrajectoryRecorder* rec = (TrajectoryRecorder*)calloc(1, sizeof(TrajectoryRecorder));
+    rec->file = f;
+    rec->creature_count = creature_count;
+    rec->coordinates = 2 * skeleton->point_count;
+    rec->max_steps = max_steps;
+    rec->frames = (float*)malloc((size_t)creature_count * max_steps * rec->coordinates * sizeof(float));
+    rec->frame_counts = (int*)calloc(creature_count, sizeof(int));
+    rec->slots = (int*)malloc(creature_count * sizeof(int));
+    for (int k = 0; k < creature_count; k++) rec->slots[k] = -1;
+    rec->encoded = (unsigned char*)malloc((size_t)max_steps * rec->coordinates * VARINT_MAX_BYTES + 4);
+
+    TrajectoryHeader* h = &rec->header;
+    h->magic = TRAJECTORY_MAGIC;
+    h->version = TRAJECTORY_VERSION;
+    h->header_size = sizeof(TrajectoryHeader);
+    h->seed = seed;
+    h->dt = dt;
+    h->quantum = TRAJECTORY_QUANTUM;
+    h->point_count = skeleton->point_count;
+    h->constraint_count = skeleton->constraint_count;
+    h->creature_count = creature_count;
+    size_t constraint_size = skeleton->constraint_count * sizeof(ConstraintDef);
+    if (fwrite(h, sizeof(*h), 1, f) != 1 || fwrite(skeleton->constraints, 1, constraint_size, f) != constraint_size) {
+        rec->failed = 1;
+    }
+    rec->offset = sizeof(*h) + constraint_size;
+    return rec;
+}
+
+int trajectory_recorder_close(TrajectoryRecorder* rec) {
+    TrajectoryHeader* h = &rec->header;
+    FILE* f = rec->file;
+    if (!rec->failed) {
+        // The index is 8-byte aligned, so it can be read in place
+        static const unsigned char zeros[8];
+        uint64_t index_offset = align_up(rec->offset, 8);
+        size_t padding = (size_t)(index_offset - rec->offset);
+        h->index_offset = index_offset;
+        h->index_count = rec->index_count;
+        int ok = fwrite(zeros, 1, padding, f) == padding;
+        ok = ok && fwrite(rec->index, sizeof(TrajectoryIndexEntry), rec->index_count, f) == (size_t)rec->index_count;
+        ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(h, sizeof(*h), 1, f) == 1;
+        if (!ok) rec->failed = 1;
+    }
+    if (fclose(f) != 0) rec->failed = 1;
+    int ok = !rec->failed;
+    free(rec->frames);
+    free(rec->frame_counts);
+    free(rec->slots);
+    free(rec->encoded);
+    free(rec->index);
+    free(rec);
+    return ok;
+}
+
+void trajectory_capture(TrajectoryRecorder* rec, int k, const PhysicsStore* ps, int slot) {
+    int step = rec->frame_counts[k];
+    if (step >= rec->max_steps) return;
+    float* frame = rec->frames + ((size_t)k * rec->max_steps + step) * rec->coordinates;
+    int points = ps->point_count;
+    for (int p = 0; p < points; p++) {
+        frame[p] = ps->x[PHYS_INDEX(ps, p, slot)];
+        frame[points + p] = ps->y[PHYS_INDEX(ps, p, slot)];
+    }
+    rec->frame_counts[k] = step + 1;
+}
+
+// Encodes `steps` buffered steps of creature `k` into rec->encoded,
+// padded to 4 bytes. Returns the padded size.
+static size_t encode(TrajectoryRecorder* rec, int k, int steps) {
+    int coordinates = rec->coordinates;
+    float inverse_quantum = 1.0f / rec->header.quantum;
+    const float* frames = rec->frames + (size_t)k * rec->max_steps * coordinates;
+    int32_t previous[coordinates], before[coordinates];
+    memset(previous, 0, sizeof(previous));
+    memset(before, 0, sizeof(before));
+    unsigned char* p = rec->encoded;
+    for (int s = 0; s < steps; s++) {
+        const float* frame = frames + (size_t)s * coordinates;
+        for (int c = 0; c < coordinates; c++) {
+            int32_t q = quantize(frame[c], inverse_quantum);
+            p = put_varint(p, zigzag(q - predict(s, previous[c], before[c])));
+            before[c] = previous[c];
+            previous[c] = q;
+        }
+    }
+    size_t size = p - rec->encoded;
+    size_t padded = align_up(size, 4);
+    memset(p, 0, padded - size);
+    return padded;
+}
+
+void trajectory_write(TrajectoryRecorder* rec, int k, int generation, int creature, float fitness) {
+    int steps = rec->frame_counts[k];
+    rec->frame_counts[k] = 0;
+    if (rec->failed || steps == 0) return;
+
+    double start = timer_now();
+    size_t size = encode(rec, k, steps);
+    TrajectoryRecord record = {TRAJECTORY_RECORD_MAGIC, generation, creature, steps, fitness, (uint32_t)size};
+    if (fwrite(&record, sizeof(record), 1, rec->file) != 1 || fwrite(rec->encoded, 1, size, rec->file) != size) {
+        printf("Could not write trajectories; recording stopped\n");
+        rec->failed = 1;
+        return;
+    }
+
+    if (rec->index_count == rec->index_capacity) {
+        rec->index_capacity = rec->index_capacity > 0 ? rec->index_capacity * 2 : 256;
+        rec->index = (TrajectoryIndexEntry*)realloc(rec->index, rec->index_capacity * sizeof(TrajectoryIndexEntry));
+    }
+    rec->index[rec->index_count++] = (TrajectoryIndexEntry){rec->offset, generation, creature};
+    rec->offset += sizeof(record) + size;
+    rec->records++;
+    rec->steps += steps;
+    rec->bytes += size;
+    rec->seconds += timer_now() - start;
+}
+
+void trajectory_discard(TrajectoryRecorder* rec) {
+    for (int k = 0; k < rec->creature_count; k++) rec->frame_counts[k] = 0;
+}
+
+// The record at `offset` if it lies whole within the file
+static const TrajectoryRecord* record_at(const TrajectoryFile* tf, uint64_t offset) {
+    size_t size = tf->file.size;
+    if (offset % 4 != 0 || offset > size || size - offset < sizeof(TrajectoryRecord)) return NULL;
+    const TrajectoryRecord* record = (const TrajectoryRecord*)(tf->file.data + offset);
+    if (record->magic != TRAJECTORY_RECORD_MAGIC || record->step_count <= 0) return NULL;
+    if (record->size > size - offset - sizeof(TrajectoryRecord)) return NULL;
+    return record;
+}
+
+// Lists the records from the index, or by walking the file when it has
+// none, e.g. because the run was interrupted. Returns 0 on a bad index.
+static int list_records(TrajectoryFile* tf) {
+    const TrajectoryHeader* h = tf->header;
+    uint64_t first = sizeof(TrajectoryHeader) + (uint64_t)h->constraint_count * sizeof(ConstraintDef);
+    if (h->index_count > 0) {
+        size_t size = tf->file.size;
+        if (h->index_offset % 8 != 0 || h->index_offset > size ||
+            (size - h->index_offset) / sizeof(TrajectoryIndexEntry) < (uint64_t)h->index_count) {
+            return 0;
+        }
+        const TrajectoryIndexEntry* index = (const TrajectoryIndexEntry*)(tf->file.data + h->index_offset);
+        tf->records = (const TrajectoryRecord**)malloc(h->index_count * sizeof(TrajectoryRecord*));
+        for (int i = 0; i < h->index_count; i++) {
+            const TrajectoryRecord* record = record_at(tf, index[i].offset);
+            if (record == NULL || index[i].offset < first) return 0;
+            tf->records[i] = record;
+        }
+        tf->record_count = h->index_count;
+        return 1;
+    }
+
+    int capacity = 0;
+    uint64_t offset = first;
+    const TrajectoryRecord* record;
+    while ((record = record_at(tf, offset)) != NULL) {
+        if (tf->record_count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 256;
+            tf->records = (const TrajectoryRecord**)realloc(tf->records, capacity * sizeof(TrajectoryRecord*));
+        }
+        tf->records[tf->record_count++] = record;
+        offset += sizeof(TrajectoryRecord) + record->size;
+    }
+    return 1;
+}
+
+TrajectoryFile* trajectory_open(const char* path) {
+    TrajectoryFile* tf = (TrajectoryFile*)calloc(1, sizeof(TrajectoryFile));
+    if (!mapped_file_open(path, &tf->file)) {
+        printf("Could not open trajectory file %s\n", path);
+        free(tf);
+        return NULL;
+    }
+    const TrajectoryHeader* h = (const TrajectoryHeader*)tf->file.data;
+    tf->header = h;
+    tf->constraints = (const ConstraintDef*)(tf->file.data + sizeof(TrajectoryHeader));
+
+    int ok = tf->file.size >= sizeof(TrajectoryHeader) && h->magic == TRAJECTORY_MAGIC &&
+             h->version == TRAJECTORY_VERSION && h->header_size == sizeof(TrajectoryHeader) && h->dt > 0 &&
+             h->quantum > 0 && h->point_count > 0 && h->constraint_count >= 0 && h->creature_count > 0 &&
+             (tf->file.size - sizeof(TrajectoryHeader)) / sizeof(ConstraintDef) >= (size_t)h->constraint_count;
+    for (int i = 0; ok && i < h->constraint_count; i++) {
+        const ConstraintDef* c = &tf->constraints[i];
+        ok = c->p1 >= 0 && c->p1 < h->point_count && c->p2 >= 0 && c->p2 < h->point_count;
+    }
+    ok = ok && list_records(tf);
+    if (!ok) {
+        printf("%s is not a trajectory file or is corrupt\n", path);
+        trajectory_close(tf);
+        return NULL;
+    }
+    return tf;
+}
+
+void trajectory_close(TrajectoryFile* tf) {
+    mapped_file_close(&tf->file);
+    free(tf->records);
+    free(tf);
+}
+
+int trajectory_find(const TrajectoryFile* tf, int generation) {
+    int low = 0, high = tf->record_count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (tf->records[mid]->generation < generation) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+int trajectory_decode(const TrajectoryFile* tf, int r, float* out) {
+    const TrajectoryRecord* record = tf->records[r];
+    int coordinates = 2 * tf->header->point_count;
+    float quantum = tf->header->quantum;
+    const unsigned char* p = (const unsigned char*)(record + 1);
+    const unsigned char* end = p + record->size;
+    int32_t previous[coordinates], before[coordinates];
+    memset(previous, 0, sizeof(previous));
+    memset(before, 0, sizeof(before));
+    for (int s = 0; s < record->step_count; s++) {
+        float* frame = out + (size_t)s * coordinates;
+        for (int c = 0; c < coordinates; c++) {
+            uint32_t residual;
+            p = get_varint(p, end, &residual);
+            if (p == NULL) return 0;
+            int32_t q = predict(s, previous[c], before[c]) + unzigzag(residual);
+            before[c] = previous[c];
+            previous[c] = q;
+            frame[c] = q * quantum;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,117 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "physics.h"
+#include "mapped_file.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRAJECTORY_MAGIC 0x4A4152544B4C4157ULL // "WALKTRAJ"
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_RECORD_MAGIC 0x4B415254u // "TRAK"
+#define TRAJECTORY_QUANTUM (1.0f / 16.0f) // Pixels per quantization step
+
+// A trajectory file holds the point positions of a few creatures after
+// every step of their evaluation, so a run can be watched again without
+// simulating it. The layout is a TrajectoryHeader, the skeleton's
+// constraint_count ConstraintDefs, then one record per creature and
+// generation in the order they finished: a TrajectoryRecord followed by
+// its encoded steps. Closing the recorder appends an index of every
+// record and points the header at it; a file without one is scanned.
+// Values are stored in native byte order.
+//
+// Steps are encoded per coordinate (x of every point, then y): positions
+// are rounded to multiples of `quantum`, predicted from the two steps
+// before (Verlet motion is nearly linear between steps), and the
+// residual is stored as a zigzag varint, mostly one byte. Decoding
+// reproduces the rounded positions exactly, so errors never accumulate.
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t seed; // Of the run
+    float dt;
+    float quantum;
+    int32_t point_count;
+    int32_t constraint_count;
+    int32_t creature_count; // Records per generation, at most
+    int32_t index_count;    // TrajectoryIndexEntries, 0 until closed
+    uint64_t index_offset;
+} TrajectoryHeader;
+
+typedef struct {
+    uint32_t magic; // TRAJECTORY_RECORD_MAGIC
+    int32_t generation;
+    int32_t creature; // Index into the population
+    int32_t step_count;
+    float fitness;
+    uint32_t size; // Bytes of encoded steps that follow
+} TrajectoryRecord;
+
+typedef struct {
+    uint64_t offset; // Of the TrajectoryRecord
+    int32_t generation;
+    int32_t creature;
+} TrajectoryIndexEntry;
+
+// Streams the trajectories of creatures [0, creature_count) of every
+// generation to a file. Steps are captured into per-creature buffers by
+// whichever worker simulates the creature, and encoded and written when
+// its evaluation ends, on the thread that joins the workers.
+typedef struct {
+    FILE* file;
+    TrajectoryHeader header;
+    int creature_count;
+    int coordinates; // Per step: x and y of every point
+    int max_steps;   // Steps buffered per creature; later ones are dropped
+
+    float* frames;     // [creature][max_steps][coordinates]
+    int* frame_counts; // [creature]
+    int* slots;        // [creature] slot during the current steps, -1 if not simulated
+
+    unsigned char* encoded; // Scratch for one record
+    uint64_t offset;        // Where the next record goes
+    TrajectoryIndexEntry* index;
+    int index_count;
+    int index_capacity;
+
+    long long records;
+    long long steps;
+    long long bytes; // Encoded step bytes written
+    double seconds;  // Spent encoding and writing
+    int failed;      // A write failed; nothing more is written
+} TrajectoryRecorder;
+
+// Returns NULL if `path` cannot be created
+TrajectoryRecorder* trajectory_recorder_create(const char* path, const PhysicsStore* skeleton, int creature_count,
+                                               int max_steps, float dt, uint64_t seed);
+// Writes the index and closes the file. Returns 0 if any write failed.
+int trajectory_recorder_close(TrajectoryRecorder* rec);
+// Appends the positions of `slot` as the next step of recorded creature `k`
+void trajectory_capture(TrajectoryRecorder* rec, int k, const PhysicsStore* ps, int slot);
+// Encodes and writes the steps of recorded creature `k`, then clears them
+void trajectory_write(TrajectoryRecorder* rec, int k, int generation, int creature, float fitness);
+// Drops the steps of every recorded creature, e.g. when a generation
+// starts over
+void trajectory_discard(TrajectoryRecorder* rec);
+
+// A trajectory file mapped for replay
+typedef struct {
+    MappedFile file;
+    const TrajectoryHeader* header;
+    const ConstraintDef* constraints;
+    const TrajectoryRecord** records; // In file order, so by generation
+    int record_count;
+} TrajectoryFile;
+
+// Returns NULL if `path` is missing or not a trajectory file
+TrajectoryFile* trajectory_open(const char* path);
+void trajectory_close(TrajectoryFile* tf);
+// First record of the first generation at or after `generation`, or
+// record_count if there is none
+int trajectory_find(const TrajectoryFile* tf, int generation);
+// Decodes record `r` into step_count * 2 * point_count floats: x of every
+// point, then y, for each step. Returns 0 if the record is corrupt.
+int trajectory_decode(const TrajectoryFile* tf, int r, float* out);
+
+#endif // TRAJECTORY_H